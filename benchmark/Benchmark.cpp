@@ -0,0 +1,300 @@
+//
+// Project: rpg_world_simulator
+// File: Benchmark.cpp
+//
+// Copyright (c) 2024 Miika 'Lehdari' Lehtimäki
+// You may use, distribute and modify this code under the terms
+// of the licence specified in file LICENSE which is distributed
+// with this source code package.
+//
+
+#include "Label.hpp"
+#include "Components.hpp"
+#include "ComponentPool.hpp"
+#include "CollisionHandler.hpp"
+#include "EntityFinder.hpp"
+#include "Food.hpp"
+#include "NPC.hpp"
+#include "ThreadPool.hpp"
+#include "World.hpp"
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+
+
+using Clock = std::chrono::high_resolution_clock;
+
+// Seed of the random streams of entities created without a world
+static constexpr uint64_t seed = 0;
+
+
+static double secondsSince(const Clock::time_point& start)
+{
+    return std::chrono::duration<double>(Clock::now() - start).count();
+}
+
+static Vec2f randomPointInDisk(float radius)
+{
+    Vec2f p;
+    do
+        p << rnd(-radius, radius), rnd(-radius, radius);
+    while (p.squaredNorm() > radius*radius);
+    return p;
+}
+
+static std::vector<Vec2f> randomPointsInDisk(std::size_t nPoints, float radius)
+{
+    std::vector<Vec2f> points(nPoints);
+    for (auto& p : points)
+        p = randomPointInDisk(radius);
+    return points;
+}
+
+static void createFood(ComponentPool<COMPONENT_TYPES>* componentPool, std::vector<Food>* food,
+    std::size_t nEntities, float worldRadius)
+{
+    componentPool->createEntities<Food>(food, nEntities, [worldRadius](std::size_t) {
+        return std::make_tuple(randomPointInDisk(worldRadius), seed, (uint64_t)0);
+    });
+}
+
+// Number of iterations so that each measurement processes roughly the same amount of entities
+static std::size_t numIterations(std::size_t nEntities, std::size_t nEntitiesTotal = 4000000)
+{
+    return std::max<std::size_t>(3, nEntitiesTotal / nEntities);
+}
+
+// One CSV row per measurement, time is the total time of all iterations
+static void printResult(const char* scenario, std::size_t nEntities, std::size_t nThreads,
+    std::size_t nIterations, double time)
+{
+    double iterationTime = time / (double)nIterations;
+    printf("%s,%zu,%zu,%zu,%.9f,%.3f,%.3f\n", scenario, nEntities, nThreads, nIterations,
+        iterationTime, iterationTime*1.0e9/(double)nEntities, 1.0/iterationTime);
+    fflush(stdout);
+}
+
+
+// Sum of positions, keeps the iteration from being optimized away
+struct PositionSum {
+    Vec2f   sum {0.0f, 0.0f};
+
+    void operator()(EntityId id, Orientation& orientation)
+    {
+        sum += orientation.getPosition();
+    }
+};
+
+static volatile float sink = 0.0f;
+
+
+// Entity creation with createEntity and createEntities (serial and parallel) followed by destruction
+// of all the entities
+static void benchmarkCreateDestroy(std::size_t nEntities)
+{
+    constexpr float worldRadius = 100.0f;
+    std::size_t nIterations = numIterations(nEntities);
+
+    ComponentPool<COMPONENT_TYPES> componentPool(nEntities);
+    auto positions = randomPointsInDisk(nEntities, worldRadius);
+    std::vector<Food> food;
+
+    auto start = Clock::now();
+    for (std::size_t i=0; i<nIterations; ++i) {
+        for (const auto& p : positions)
+            food.emplace_back(componentPool.createEntity<Food>(p, seed, (uint64_t)0));
+        food.clear();
+    }
+    printResult("create_destroy", nEntities, 1, nIterations, secondsSince(start));
+
+    start = Clock::now();
+    for (std::size_t i=0; i<nIterations; ++i) {
+        componentPool.createEntities<Food>(&food, nEntities, [&](std::size_t j) {
+            return std::make_tuple(positions[j], seed, (uint64_t)0);
+        });
+        food.clear();
+    }
+    printResult("create_destroy_bulk", nEntities, 1, nIterations, secondsSince(start));
+
+    ThreadPool threadPool;
+    start = Clock::now();
+    for (std::size_t i=0; i<nIterations; ++i) {
+        componentPool.createEntities<Food>(&food, nEntities, [&](std::size_t j) {
+            return std::make_tuple(positions[j], seed, (uint64_t)0);
+        }, &threadPool);
+        food.clear();
+    }
+    printResult("create_destroy_bulk_parallel", nEntities, threadPool.getNumThreads(), nIterations,
+        secondsSince(start));
+}
+
+// Iteration over components with runSystem
+static void benchmarkRunSystem(std::size_t nEntities)
+{
+    std::size_t nIterations = numIterations(nEntities, 100000000);
+
+    ComponentPool<COMPONENT_TYPES> componentPool(nEntities);
+    std::vector<Food> food;
+    createFood(&componentPool, &food, nEntities, 100.0f);
+
+    PositionSum positionSum;
+    auto start = Clock::now();
+    for (std::size_t i=0; i<nIterations; ++i)
+        componentPool.runSystem<PositionSum, Orientation>(&positionSum);
+    printResult("run_system", nEntities, 1, nIterations, secondsSince(start));
+    sink = positionSum.sum(0);
+}
+
+// Entity move and copy, both go through the ComponentPool callbacks of the entity
+static void benchmarkMoveCopy(std::size_t nEntities)
+{
+    std::size_t nIterations = numIterations(nEntities);
+
+    ComponentPool<COMPONENT_TYPES> componentPool(nEntities);
+    std::vector<Food> food;
+    createFood(&componentPool, &food, nEntities, 100.0f);
+
+    std::vector<Food> moved;
+    moved.reserve(nEntities);
+    auto start = Clock::now();
+    for (std::size_t i=0; i<nIterations; ++i) {
+        for (auto& f : food)
+            moved.emplace_back(std::move(f));
+        food.swap(moved);
+        moved.clear();
+    }
+    printResult("entity_move", nEntities, 1, nIterations, secondsSince(start));
+
+    // Copies are destroyed within the measurement
+    std::vector<Food> copies;
+    copies.reserve(nEntities);
+    componentPool.reserveEntities<Food>(nEntities);
+    start = Clock::now();
+    for (std::size_t i=0; i<nIterations; ++i) {
+        for (const auto& f : food)
+            copies.emplace_back(f);
+        copies.clear();
+    }
+    printResult("entity_copy", nEntities, 1, nIterations, secondsSince(start));
+}
+
+// World filled with food at maximum density and one NPC per ten food
+static void benchmarkWorld(std::size_t nEntities)
+{
+    constexpr std::size_t nQueries = 10000;
+    constexpr double queryRadius = 4.0;
+    std::size_t nNPCs = nEntities / 10;
+    std::size_t nFood = nEntities - nNPCs;
+    double worldSize = std::sqrt((double)nFood*5.0*5.0 / PI); // World::getMaxFood is nFood
+
+    ComponentPool<COMPONENT_TYPES> componentPool(nEntities);
+    World world(&componentPool, worldSize);
+    CollisionHandler collisionHandler(&componentPool, &world);
+    for (std::size_t i=0; i<nNPCs; ++i)
+        world.createEntity<NPC>(randomPointInDisk((float)worldSize));
+    for (std::size_t i=0; i<nFood; ++i)
+        world.createEntity<Food>(randomPointInDisk((float)worldSize));
+    // Queued entities get created during the first update
+    world.update(&collisionHandler);
+
+    std::size_t nWorldEntities = world.getNumEntities<NPC>() + world.getNumEntities<Food>();
+    std::size_t nThreads = world.getThreadPool()->getNumThreads();
+
+    std::size_t nTicks = numIterations(nEntities, 10000000);
+    auto start = Clock::now();
+    for (std::size_t i=0; i<nTicks; ++i)
+        world.update(&collisionHandler);
+    printResult("world_update", nWorldEntities, nThreads, nTicks, secondsSince(start));
+    nWorldEntities = world.getNumEntities<NPC>() + world.getNumEntities<Food>();
+
+    auto queryPoints = randomPointsInDisk(nQueries, (float)worldSize);
+    std::vector<std::pair<EntityId, TypeId>> entityHandles;
+
+    start = Clock::now();
+    for (const auto& p : queryPoints) {
+        entityHandles.clear();
+        world.getEntitiesWithinRadius(p, queryRadius, &entityHandles);
+    }
+    printResult("query_radius", nWorldEntities, 1, nQueries, secondsSince(start));
+
+    std::size_t nFound = 0;
+    start = Clock::now();
+    for (const auto& p : queryPoints)
+        nFound += world.findNearest<Food>(p, queryRadius) != nullptr;
+    printResult("query_nearest", nWorldEntities, 1, nQueries, secondsSince(start));
+    sink = (float)nFound;
+
+    // Brute force radius query over all entities for reference
+    EntityFinder entityFinder;
+    entityFinder.radius = queryRadius;
+    entityFinder.entityHandles = &entityHandles;
+    std::size_t nBruteForceQueries = numIterations(nEntities, 10000000);
+    start = Clock::now();
+    for (std::size_t i=0; i<nBruteForceQueries; ++i) {
+        entityHandles.clear();
+        entityFinder.point = queryPoints[i % nQueries];
+        componentPool.runSystem<EntityFinder, Label, Orientation>(&entityFinder);
+    }
+    printResult("query_brute_force", nWorldEntities, 1, nBruteForceQueries, secondsSince(start));
+}
+
+// Scaling of a read-only system with the number of threads
+static void benchmarkParallelSystem(std::size_t nEntities)
+{
+    constexpr float worldRadius = 100.0f;
+    std::size_t nIterations = numIterations(nEntities, 20000000);
+
+    ComponentPool<COMPONENT_TYPES> componentPool(nEntities);
+    std::vector<Food> food;
+    createFood(&componentPool, &food, nEntities, worldRadius);
+
+    std::vector<std::pair<EntityId, TypeId>> entityHandles;
+    EntityFinder entityFinder;
+    entityFinder.radius = worldRadius*0.5f;
+    entityFinder.entityHandles = &entityHandles;
+
+    for (std::size_t nThreads=1; nThreads<=std::max(std::thread::hardware_concurrency(), 1u); nThreads*=2) {
+        ThreadPool threadPool(nThreads);
+        auto start = Clock::now();
+        for (std::size_t i=0; i<nIterations; ++i) {
+            entityHandles.clear();
+            componentPool.runSystemParallel<EntityFinder, Label, Orientation>(&entityFinder, &threadPool);
+        }
+        printResult("parallel_system", nEntities, nThreads, nIterations, secondsSince(start));
+    }
+}
+
+
+// Writes results as CSV to stdout. An iteration is a single tick in world_update, a single query in
+// the query scenarios and a pass over all entities in the other scenarios.
+int main(int argc, char* argv[])
+{
+    if (argc > 2) {
+        fprintf(stderr, "Usage: %s [max number of entities, at least 1000]\n", argv[0]);
+        return 1;
+    }
+
+    std::size_t maxEntities = 1000000;
+    if (argc == 2) {
+        char* end = nullptr;
+        long long value = std::strtoll(argv[1], &end, 10);
+        if (*end != '\0' || value < 1000) {
+            fprintf(stderr, "Invalid max number of entities: %s\n", argv[1]);
+            fprintf(stderr, "Usage: %s [max number of entities, at least 1000]\n", argv[0]);
+            return 1;
+        }
+        maxEntities = (std::size_t)value;
+    }
+
+    printf("scenario,entities,threads,iterations,seconds_per_iteration,ns_per_entity,iterations_per_s\n");
+    for (std::size_t nEntities=1000; nEntities<=maxEntities; nEntities*=10) {
+        benchmarkCreateDestroy(nEntities);
+        benchmarkRunSystem(nEntities);
+        benchmarkMoveCopy(nEntities);
+        benchmarkWorld(nEntities);
+        benchmarkParallelSystem(nEntities);
+    }
+
+    return 0;
+}
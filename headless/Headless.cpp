@@ -0,0 +1,87 @@
+//
+// Project: rpg_world_simulator
+// File: Headless.cpp
+//
+// Copyright (c) 2024 Miika 'Lehdari' Lehtimäki
+// You may use, distribute and modify this code under the terms
+// of the licence specified in file LICENSE which is distributed
+// with this source code package.
+//
+
+#include "Components.hpp"
+#include "ComponentPool.hpp"
+#include "CollisionHandler.hpp"
+#include "Tracer.hpp"
+#include "World.hpp"
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+
+// Run the simulation without a window as fast as possible
+int main(int argc, char* argv[])
+{
+    const char* programName = argv[0];
+
+    // Serial entity updates for comparison with the default parallel ones
+    bool serial = argc >= 2 && std::strcmp(argv[1], "--serial") == 0;
+    if (serial) {
+        --argc;
+        ++argv;
+    }
+
+    if (argc > 3) {
+        fprintf(stderr, "Usage: %s [--serial] [number of ticks] [trace file]\n", programName);
+        return 1;
+    }
+
+    long nTicks = 10000;
+    if (argc >= 2) {
+        char* end = nullptr;
+        nTicks = std::strtol(argv[1], &end, 10);
+        if (*end != '\0' || nTicks < 0) {
+            fprintf(stderr, "Invalid number of ticks: %s\n", argv[1]);
+            return 1;
+        }
+    }
+
+    // Optional Chrome trace of the whole run
+    const char* traceFileName = argc == 3 ? argv[2] : nullptr;
+#ifndef RPG_WORLD_SIMULATOR_TRACING
+    if (traceFileName != nullptr) {
+        fprintf(stderr, "Tracing disabled at compile time, enable RPG_WORLD_SIMULATOR_TRACING\n");
+        return 1;
+    }
+#endif
+
+    ComponentPool<COMPONENT_TYPES> componentPool;
+    World world(&componentPool);
+    CollisionHandler collisionHandler(&componentPool, &world);
+    world.setUpdateMode(serial ? World::UpdateMode::Serial : World::UpdateMode::Parallel);
+
+    if (traceFileName != nullptr)
+        Tracer::instance().start();
+
+    auto start = std::chrono::steady_clock::now();
+    for (long i=0; i<nTicks; ++i)
+        world.update(&collisionHandler);
+    double time = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    if (traceFileName != nullptr) {
+        Tracer::instance().stop();
+        if (!Tracer::instance().write(traceFileName)) {
+            fprintf(stderr, "Could not write trace file %s\n", traceFileName);
+            return 1;
+        }
+    }
+
+    printf("ticks: %ld\n", nTicks);
+    printf("time: %.3f s\n", time);
+    printf("ticks/s: %.1f\n", time > 0.0 ? (double)nTicks / time : 0.0);
+    printf("NPCs: %zu\n", world.getNumEntities<NPC>());
+    printf("food: %zu\n", world.getNumEntities<Food>());
+
+    return 0;
+}
@@ -0,0 +1,71 @@
+//
+// Project: rpg_world_simulator
+// File: BroadPhase.hpp
+//
+// Copyright (c) 2024 Miika 'Lehdari' Lehtimäki
+// You may use, distribute and modify this code under the terms
+// of the licence specified in file LICENSE which is distributed
+// with this source code package.
+//
+
+#pragma once
+
+#include "Entity.hpp"
+#include "Entities.hpp"
+
+#include <gut_utils/MathTypes.hpp>
+
+#include <cstdint>
+#include <vector>
+
+
+class Label;
+class CollisionBody;
+class Orientation;
+
+
+// Collision broad phase generating candidate pairs of bodies with overlapping bounding boxes.
+// Bodies are gathered by running the broad phase as a system, after which build() inserts each
+// body into all cells of a uniform grid its bounding box overlaps. Cell size follows the mean
+// body radius, so a few large bodies occupy more cells instead of coarsening the whole grid.
+// Bodies with a non-finite position or radius are left out.
+class BroadPhase {
+public:
+    struct Body {
+        EntityId    id;
+        TypeId      entityTypeId;
+        Vec2f       position;
+        float       radius;
+    };
+
+    BroadPhase();
+
+    // Discard all bodies, call before running the broad phase as a system
+    void clear();
+
+    void operator()(EntityId id, Label& label, CollisionBody& collisionBody, Orientation& orientation);
+
+    // Generate the candidate pairs, call after running the broad phase as a system
+    void build();
+
+    // Candidate pairs (smaller id first), ordered by the larger id and then by the smaller one
+    const std::vector<std::pair<EntityId, EntityId>>& getPairs() const;
+
+private:
+    std::vector<Body>                           _bodies;
+
+    float                                       _cellSize;
+    float                                       _cellSizeInv;
+    Vec2f                                       _min;       // grid origin in world coordinates
+    int32_t                                     _width;
+    int32_t                                     _height;
+
+    std::vector<uint32_t>                       _cellStarts;
+    std::vector<uint32_t>                       _cellFill;
+    std::vector<uint32_t>                       _cellBodies; // body indices sorted by cell
+
+    std::vector<std::pair<EntityId, EntityId>>  _pairs;
+
+    int32_t cellX(float x) const;
+    int32_t cellY(float y) const;
+};
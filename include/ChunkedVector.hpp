@@ -0,0 +1,90 @@
+//
+// Project: rpg_world_simulator
+// File: ChunkedVector.hpp
+//
+// Copyright (c) 2024 Miika 'Lehdari' Lehtimäki
+// You may use, distribute and modify this code under the terms
+// of the licence specified in file LICENSE which is distributed
+// with this source code package.
+//
+
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+
+// Vector-like container storing its elements in fixed size pages. Pages are never reallocated,
+// so growing the container does not move the existing elements. Pages are filled with default
+// constructed elements when allocated, emplace_back assigns to the next free slot.
+template <typename T, std::size_t T_PageSize = 1024>
+class ChunkedVector {
+public:
+    static_assert((T_PageSize & (T_PageSize-1)) == 0, "T_PageSize must be a power of two");
+    static constexpr std::size_t pageSize = T_PageSize;
+
+    ChunkedVector() :
+        _size   (0)
+    {
+    }
+
+    T& operator[](std::size_t i)
+    {
+        return _pages[i / T_PageSize][i % T_PageSize];
+    }
+
+    const T& operator[](std::size_t i) const
+    {
+        return _pages[i / T_PageSize][i % T_PageSize];
+    }
+
+    T& back()
+    {
+        return (*this)[_size-1];
+    }
+
+    std::size_t size() const
+    {
+        return _size;
+    }
+
+    bool empty() const
+    {
+        return _size == 0;
+    }
+
+    std::size_t capacity() const
+    {
+        return _pages.size() * T_PageSize;
+    }
+
+    void reserve(std::size_t capacity)
+    {
+        while (_pages.size() * T_PageSize < capacity)
+            _pages.emplace_back(std::make_unique<T[]>(T_PageSize));
+    }
+
+    template <typename... T_Args>
+    T& emplace_back(T_Args&&... args)
+    {
+        reserve(_size+1);
+        T& element = (*this)[_size++];
+        element = T(std::forward<T_Args>(args)...);
+        return element;
+    }
+
+    void pop_back()
+    {
+        --_size;
+    }
+
+    void clear()
+    {
+        _size = 0;
+    }
+
+private:
+    std::vector<std::unique_ptr<T[]>>   _pages;
+    std::size_t                         _size;
+};
@@ -13,6 +13,12 @@
 #include "Components.hpp"
 #include "Entity.hpp"
 #include "Entities.hpp"
+#include "BroadPhase.hpp"
+#include "Interactions.hpp"
+
+#include <array>
+#include <functional>
+#include <vector>
 
 
 class Label;
@@ -24,65 +30,72 @@ class World;
 
 class CollisionHandler {
 public:
-    CollisionHandler(ComponentPool<COMPONENT_TYPES>* componentPool, World* world);
-
-    void operator()(EntityId id, Label& label, CollisionBody& collisionBody, Orientation& orientation);
+    // Overlapping pair of bodies. A has the smaller entity type id, or the smaller entity id if
+    // the types are the same. The overlap is not stored as contacts resolved earlier may move
+    // the bodies, resolution checks the current overlap instead.
+    struct Contact {
+        EntityId    idA;
+        EntityId    idB;
+        uint32_t    typePair;       // entity type id of A * N_ENTITY_TYPES + entity type id of B
+    };
 
-    #include "CollisionHandlers.inl"
+    static constexpr uint32_t nTypePairs = N_ENTITY_TYPES*N_ENTITY_TYPES;
 
-    // Function template that injects the type information, _collisionCallbacks is filled with pointers
-    // (CollisionCallback) to this function
-    template <typename T_Entity1, typename T_Entity2>
-    static void handleCollision(World* world, void* entity1, void* entity2);
+    // Entities of a contact that handleCollision writes to
+    enum class Writes {
+        A,
+        B,
+        Both
+    };
 
-    using CollisionCallback = void(*)(World*, void*, void*);
-    // Array of function pointers for all collision type pairs
-    using CollisionCallBackArray = std::array<CollisionCallback, N_ENTITY_TYPES*N_ENTITY_TYPES>;
+    CollisionHandler(ComponentPool<COMPONENT_TYPES>* componentPool, World* world);
 
-    // Initialization machinery for _collisionCallbacks
-    template<typename T_First1, typename... T_Rest1>
-    struct CallbacksInitializer {
-        template<typename T_First2, typename... T_Rest2>
-        static void callbacksInitializer(CollisionCallback* callback)
-        {
-            // Check that the function for these types have been implemented
-            constexpr bool hasHandleCollisionForTheTypes = requires(World* w, T_First1* a, T_First2* b) {
-                CollisionHandler::handleCollision(w, a, b);
-            };
-            if constexpr (!hasHandleCollisionForTheTypes || entityTypeId<T_First1>() > entityTypeId<T_First2>())
-                *callback = nullptr; // omit these so that mirrored handleCollision function definitions are not needed
-            else
-                *callback = handleCollision<T_First1, T_First2>;
-            if constexpr (sizeof...(T_Rest2) > 0)
-                callbacksInitializer<T_Rest2...>(callback+1);
-        }
+    // Contacts are generated from the broad phase pairs in parallel chunks of this many pairs.
+    // The contacts of each type pair are split into batches in which no two contacts share an
+    // entity written by handleCollision (see writes in CollisionHandlers.inl), and the contacts of
+    // a batch are resolved in parallel in chunks of this many contacts, each with its own
+    // interaction buffer. Contacts not fitting in maxBatches batches go to a final serial batch.
+    static constexpr std::size_t pairChunkSize = 256;
+    static constexpr uint32_t maxBatches = 64;
 
-        template <typename... T_Rest2>
-        static void callbacksInitializerOuter(CollisionCallback* callback)
-        {
-            callbacksInitializer<T_Rest2...>(callback);
-            if constexpr (sizeof...(T_Rest1) > 0)
-                CallbacksInitializer<T_Rest1...>::template callbacksInitializerOuter<T_Rest2...>(
-                    callback+N_ENTITY_TYPES);
-        }
-    };
+    // Generate the contacts and resolve them by calling the handleCollision functions, then commit
+    // the interactions they recorded. Chunks run on the thread pool of the world unless it is in
+    // the serial update mode, the result is the same in both.
+    void run();
 
-    friend class CollisionSubHandler;
+    #include "CollisionHandlers.inl"
 
 private:
-    class CollisionSubHandler {
-    public:
-        ComponentPool<COMPONENT_TYPES>* componentPool;
-        World*                          world;
-        EntityId                        outerId;
-        Label*                          outerLabel;
-        CollisionBody*                  outerCollisionBody;
-        Orientation*                    outerOrientation;
-
-        void operator()(EntityId id, Label& label, CollisionBody& collisionBody, Orientation& orientation);
-    };
-
     ComponentPool<COMPONENT_TYPES>* _componentPool;
-    CollisionSubHandler             _subHandler;
-    static CollisionCallBackArray   _collisionCallbacks;
+    World*                          _world;
+    BroadPhase                      _broadPhase;
+    std::vector<std::vector<Contact>>   _chunkContacts; // per chunk of broad phase pairs
+    std::vector<Contact>            _contacts; // sorted by type pair
+    std::array<uint32_t, nTypePairs+1>  _typePairStarts;
+    std::vector<uint64_t>           _entityBatches; // batches used per entity index as a bit mask
+    std::vector<uint32_t>           _contactBatches;
+    std::vector<uint32_t>           _batchStarts;
+    std::vector<Contact>            _batchedContacts;
+    std::vector<Interactions>       _interactions; // per chunk of contacts
+    std::vector<Interactions::Eat>  _eats;
+
+    // Call task(chunkId) for all chunkId in [0, nChunks), on the thread pool of the world in the
+    // parallel update mode
+    void runChunks(std::size_t nChunks, const std::function<void(std::size_t)>& task);
+    // Overlap of the bodies of two entities with their current positions, negative if apart
+    float getPenetration(EntityId id1, EntityId id2);
+    // Write the contacts among the broad phase pairs [begin, end) to contacts
+    void generateContacts(std::size_t begin, std::size_t end, std::vector<Contact>* contacts);
+    // Gather the contacts of the first nChunks chunks, sorted by type pair
+    void sortContacts(std::size_t nChunks);
+    // Greedy coloring of the contacts [begin, end) of type pair typePair into batches by the
+    // entities written for the type pair, the contacts are reordered by batch
+    void buildBatches(uint32_t typePair, std::size_t begin, std::size_t end);
+    // Resolve the contacts [begin, end) of type pair typePair
+    void resolveContacts(uint32_t typePair, std::size_t begin, std::size_t end, Interactions* interactions);
+    // Loop specialized for the type pair, calls handleCollision without indirection
+    template <uint32_t T_TypePair>
+    void resolveContacts(std::size_t begin, std::size_t end, Interactions* interactions);
+    // Resolve conflicting intents recorded by the first nChunks chunks and commit them in a single pass
+    void commitInteractions(std::size_t nChunks);
 };
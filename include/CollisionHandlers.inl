@@ -10,6 +10,18 @@
 
 // Definitions for all collision handling functions
 // Make sure to have the types in the same order as they are listed in ENTITY_TYPES (see Entities.hpp)
-static void handleCollision(World* world, NPC* npc1, NPC* npc2);
-static void handleCollision(World* world, NPC* npc, Food* food);
-static void handleCollision(World* world, Food* food1, Food* food2);
+// Changes to entities other than the colliding pair need to be recorded as interactions
+static void handleCollision(World* world, Interactions* interactions, NPC* npc1, NPC* npc2);
+static void handleCollision(World* world, Interactions* interactions, NPC* npc, Food* food);
+static void handleCollision(World* world, Interactions* interactions, Food* food1, Food* food2);
+
+// Entities written by handleCollision of each type pair. Contacts sharing a written entity go to
+// different batches, while an entity that is only read may be shared by all contacts of a batch,
+// so for example NPCs crowding around the same food are resolved in parallel. The handler must
+// not write the read-only entity, changes to it need to be recorded as interactions.
+static constexpr Writes writes(NPC*, NPC*) { return Writes::Both; }
+static constexpr Writes writes(NPC*, Food*) { return Writes::A; }
+static constexpr Writes writes(Food*, Food*) { return Writes::Both; }
+
+// Commit functions for the interactions
+static void commitEat(World* world, NPC* npc, Food* food);
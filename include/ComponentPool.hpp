@@ -11,20 +11,41 @@
 #pragma once
 
 #include "Entity.hpp"
+#include "ChunkedVector.hpp"
+#include "ThreadPool.hpp"
+#include <algorithm>
 #include <cstdint>
+#include <memory>
 
 
+// Thread local worker type of a system used by ComponentPool::runSystemParallel: T_System::Worker
+// if the system defines one, otherwise a copy of the system itself
+template <typename T_System>
+struct SystemWorker {
+    using Type = T_System;
+};
+
+template <typename T_System> requires requires { typename T_System::Worker; }
+struct SystemWorker<T_System> {
+    using Type = typename T_System::Worker;
+};
+
+
+// Components are stored in archetypes, tightly packed tables containing all entities with the same
+// set of components. Systems iterate only the archetypes matching their components. Component
+// storage is paged so components never move when the pool grows. Entities must not be created or
+// destroyed from inside a system.
 template <typename... T_Components>
 class ComponentPool
 {
 public:
     ComponentPool(uint64_t preallocation = 0) :
-        _entityHandles      (preallocation, nullptr),
-        _componentMasks     (preallocation, 0x0000000000000000),
-        _componentMovers    (preallocation, nullptr),
         _nRunningSystems    (0)
     {
-        std::apply([this](auto&&... components) {((components.resize(_entityHandles.size())), ...);}, _components);
+        _entityHandles.reserve(preallocation);
+        _entityLocations.reserve(preallocation);
+        _componentMovers.reserve(preallocation);
+        _generations.reserve(preallocation);
     }
 
     ComponentPool(ComponentPool&&) = delete;
@@ -40,24 +61,135 @@ public:
         return entity;
     }
 
+    // Create count entities of type T_Entity directly into entities, a container supporting reserve,
+    // capacity and emplace_back. generator(i) returns the constructor arguments (excluding the base entity)
+    // of the i:th entity as a std::tuple. Storage is reserved once up front. If threadPool is
+    // provided and there is more than a page of entities, the ids and rows are allocated serially and
+    // the generator and the entity constructors are then run in parallel page by page, so both need
+    // to be thread safe. The ids, components and order in entities are the same in both cases.
+    template <typename T_Entity, typename T_Container, typename T_Generator>
+    void createEntities(T_Container* entities, std::size_t count, T_Generator&& generator,
+        ThreadPool* threadPool = nullptr)
+    {
+        reserveEntities<T_Entity>(count);
+        reserveGrowth(*entities, entities->size() + count);
+
+        T_Entity* dummy = nullptr; // required for type deduction in constructEntity
+        if (threadPool == nullptr || count <= pageSize) {
+            auto construct = [&](auto&&... args) {
+                entities->emplace_back(constructEntity(dummy), std::forward<decltype(args)>(args)...);
+            };
+            for (std::size_t i=0; i<count; ++i)
+                std::apply(construct, generator(i));
+            return;
+        }
+
+        std::vector<EntityId> ids(count);
+        for (auto& id : ids)
+            id = allocateRow(dummy);
+
+        // Constructed in temporary storage, moving them to the container afterwards only updates
+        // the entity handles
+        std::allocator<T_Entity> allocator;
+        T_Entity* constructed = allocator.allocate(count);
+        threadPool->parallelFor((count + pageSize - 1) / pageSize, [&](std::size_t chunkId) {
+            for (std::size_t i=chunkId*pageSize; i<std::min(count, (chunkId+1)*pageSize); ++i) {
+                std::apply([&](auto&&... args) {
+                    std::construct_at(constructed+i, attachEntity(dummy, ids[i]), std::forward<decltype(args)>(args)...);
+                }, generator(i));
+            }
+        });
+        for (std::size_t i=0; i<count; ++i) {
+            entities->emplace_back(std::move(constructed[i]));
+            std::destroy_at(constructed+i);
+        }
+        allocator.deallocate(constructed, count);
+    }
+
+    // Reserve storage for count more entities of type T_Entity
+    template <typename T_Entity>
+    void reserveEntities(std::size_t count)
+    {
+        if (count > _freeIndices.size()) {
+            std::size_t nSlots = _entityHandles.size() + count - _freeIndices.size();
+            reserveGrowth(_entityHandles, nSlots);
+            reserveGrowth(_entityLocations, nSlots);
+            reserveGrowth(_componentMovers, nSlots);
+            reserveGrowth(_generations, nSlots);
+        }
+
+        T_Entity* dummy = nullptr; // required for type deduction in reserveRows
+        reserveRows(dummy, count);
+    }
+
     template <typename T_System, typename... T_SystemComponents>
     void runSystem(T_System* system)
     {
         ++_nRunningSystems;
         constexpr auto mask = componentMask<T_SystemComponents...>();
-        for (EntityId id=0; id<_entityHandles.size(); ++id) {
-            if ((mask & _componentMasks[id]) == mask) {
-                (*system)(id, std::get<std::vector<T_SystemComponents>>(_components)[id]...);
-            }
+        for (auto& archetype : _archetypes) {
+            if ((mask & archetype.mask) == mask)
+                runSystemOnRows<T_System, T_SystemComponents...>(system, &archetype, 0, archetype.entityIds.size());
+        }
+        --_nRunningSystems;
+    }
+
+    // Parallel variant of runSystem, archetype rows are split into chunks run on threadPool. Each
+    // chunk gets its own worker constructed from *system (see SystemWorker), and if the system
+    // defines merge(Worker&) the workers are merged back in chunk order, so that the result does
+    // not depend on the number of threads.
+    template <typename T_System, typename... T_SystemComponents>
+    void runSystemParallel(T_System* system, ThreadPool* threadPool, std::size_t chunkSize = pageSize)
+    {
+        using Worker = typename SystemWorker<T_System>::Type;
+
+        ++_nRunningSystems;
+        constexpr auto mask = componentMask<T_SystemComponents...>();
+        std::vector<Chunk> chunks;
+        for (auto& archetype : _archetypes) {
+            if ((mask & archetype.mask) != mask)
+                continue;
+            for (std::size_t begin=0; begin<archetype.entityIds.size(); begin+=chunkSize)
+                chunks.push_back({&archetype, begin, std::min(begin+chunkSize, archetype.entityIds.size())});
+        }
+
+        std::vector<Worker> workers;
+        workers.reserve(chunks.size());
+        for (std::size_t i=0; i<chunks.size(); ++i)
+            workers.emplace_back(*system);
+
+        threadPool->parallelFor(chunks.size(), [&](std::size_t chunkId) {
+            const auto& chunk = chunks[chunkId];
+            runSystemOnRows<Worker, T_SystemComponents...>(&workers[chunkId], chunk.archetype, chunk.begin, chunk.end);
+        });
+
+        if constexpr (requires(Worker& worker) { system->merge(worker); }) {
+            for (auto& worker : workers)
+                system->merge(worker);
         }
         --_nRunningSystems;
     }
 
+    // Returns nullptr for destroyed entities
     void* getEntityHandle(EntityId id)
     {
-        if (id > _entityHandles.size())
+        EntityId index = entityIndex(id);
+        if (index >= _entityHandles.size() || _generations[index] != entityGeneration(id))
             return nullptr;
-        return _entityHandles[id];
+        return _entityHandles[index];
+    }
+
+    // Number of entity slots, all entity indices are smaller than this
+    std::size_t getNumEntitySlots() const
+    {
+        return _entityHandles.size();
+    }
+
+    template <typename T_Component>
+    T_Component& getComponent(EntityId id)
+    {
+        const auto& location = _entityLocations[entityIndex(id)];
+        return std::get<ChunkedVector<T_Component>>(_archetypes[location.archetype].components)[location.row];
     }
 
     template <typename... T_MaskComponents>
@@ -73,39 +205,105 @@ public:
     friend class Entity;
 
 private:
+    static constexpr std::size_t pageSize = ChunkedVector<EntityId>::pageSize;
+
+    struct Archetype {
+        uint64_t                                        mask;
+        std::vector<EntityId>                           entityIds;  // entity of each row
+        std::tuple<ChunkedVector<T_Components>...>      components; // vectors not in mask are left empty
+    };
+
+    struct EntityLocation {
+        std::size_t archetype   {0};
+        std::size_t row         {0};
+    };
+
+    struct Chunk {
+        Archetype*  archetype;
+        std::size_t begin;
+        std::size_t end;
+    };
+
+    template <typename T_System, typename... T_SystemComponents>
+    static void runSystemOnRows(T_System* system, Archetype* archetype, std::size_t begin, std::size_t end)
+    {
+        // Rows within a page are contiguous
+        for (std::size_t pageBegin=begin; pageBegin<end;) {
+            std::size_t pageEnd = std::min(end, (pageBegin/pageSize + 1)*pageSize);
+            const EntityId* entityIds = &archetype->entityIds[pageBegin];
+            std::tuple<T_SystemComponents*...> components(
+                &std::get<ChunkedVector<T_SystemComponents>>(archetype->components)[pageBegin]...);
+            for (std::size_t i=0; i<pageEnd-pageBegin; ++i)
+                (*system)(entityIds[i], std::get<T_SystemComponents*>(components)[i]...);
+            pageBegin = pageEnd;
+        }
+    }
+
     void destroyEntity(EntityId entityId)
     {
-        _entityHandles[entityId] = nullptr;
-        _componentMasks[entityId] = 0x0000000000000000;
+        EntityId index = entityIndex(entityId);
+        auto location = _entityLocations[index];
+        auto& archetype = _archetypes[location.archetype];
+
+        // Move the last row in place of the destroyed one
+        std::size_t lastRow = archetype.entityIds.size()-1;
+        if (location.row != lastRow) {
+            EntityId movedId = archetype.entityIds[lastRow];
+            archetype.entityIds[location.row] = movedId;
+            std::apply([&](auto&... components) {
+                ((components.empty() ? void() : void(components[location.row] = std::move(components[lastRow]))), ...);
+            }, archetype.components);
+            EntityId movedIndex = entityIndex(movedId);
+            _entityLocations[movedIndex].row = location.row;
+            if (_entityHandles[movedIndex] != nullptr)
+                (this->*_componentMovers[movedIndex])(_entityHandles[movedIndex]);
+        }
+        archetype.entityIds.pop_back();
+        std::apply([](auto&... components) {
+            ((components.empty() ? void() : components.pop_back()), ...);
+        }, archetype.components);
+
+        freeEntityId(entityId);
     }
 
     void moveEntity(EntityId entityId, void* newLocation)
     {
-        _entityHandles[entityId] = newLocation;
+        _entityHandles[entityIndex(entityId)] = newLocation;
     }
 
     template <typename... T_EntityComponents>
     void copyEntity(const Entity<T_EntityComponents...>& oldEntity, Entity<T_EntityComponents...>* newEntity)
     {
-        newEntity->_id = findFreeEntityId();
-        _componentMasks[newEntity->_id] = componentMask<T_EntityComponents...>();
-        _componentMovers[newEntity->_id] = &ComponentPool<T_Components...>::moveComponents<T_EntityComponents...>;
-        copyComponent<Entity<T_EntityComponents...>, T_EntityComponents...>(oldEntity, newEntity);
-        _entityHandles[newEntity->_id] = newEntity;
+        newEntity->_id = allocateEntityId();
+        addRow<T_EntityComponents...>(newEntity->_id);
+        moveComponents<Entity<T_EntityComponents...>, T_EntityComponents...>(newEntity);
+        ((*std::get<T_EntityComponents*>(newEntity->_components) =
+            *std::get<T_EntityComponents*>(oldEntity._components)), ...);
+        _entityHandles[entityIndex(newEntity->_id)] = newEntity;
     }
 
-    EntityId findFreeEntityId()
+    EntityId allocateEntityId()
     {
-        for (EntityId id=0; id<_entityHandles.size(); ++id) {
-            if (_entityHandles[id] == nullptr)
-                return id;
+        if (!_freeIndices.empty()) {
+            EntityId index = _freeIndices.back();
+            _freeIndices.pop_back();
+            return makeEntityId(index, _generations[index]);
         }
 
         _entityHandles.push_back(nullptr);
-        _componentMasks.push_back(0x0000000000000000);
+        _entityLocations.emplace_back();
         _componentMovers.push_back(nullptr);
-        resizeComponentStorage(_entityHandles.size());
-        return _entityHandles.size()-1;
+        _generations.push_back(0);
+        return makeEntityId(_entityHandles.size()-1, 0);
+    }
+
+    void freeEntityId(EntityId entityId)
+    {
+        EntityId index = entityIndex(entityId);
+        _entityHandles[index] = nullptr;
+        _componentMovers[index] = nullptr;
+        ++_generations[index]; // invalidates all copies of entityId
+        _freeIndices.push_back(index);
     }
 
     template <typename... T_EntityComponents>
@@ -117,48 +315,79 @@ private:
     template <typename... T_EntityComponents>
     Entity<T_EntityComponents...> constructEntity()
     {
-        auto entity = Entity<T_EntityComponents...>(this, findFreeEntityId());
-        _componentMasks[entity._id] = componentMask<T_EntityComponents...>();
-        _componentMovers[entity._id] = &ComponentPool<T_Components...>::moveComponents<T_EntityComponents...>;
-        constructComponent<Entity<T_EntityComponents...>, T_EntityComponents...>(&entity);
-        return entity;
+        EntityId id = allocateEntityId();
+        addRow<T_EntityComponents...>(id);
+        return attachEntity<T_EntityComponents...>(id);
     }
 
-    template <typename T_Entity, typename T_FirstComponent, typename... T_RestComponents>
-    void constructComponent(T_Entity* entity)
+    // Allocate an id and a row of default constructed components for it
+    template <typename... T_EntityComponents>
+    EntityId allocateRow(Entity<T_EntityComponents...>* dummy) // dummy needed for component type deduction
     {
-        auto& componentVector = std::get<std::vector<T_FirstComponent>>(_components);
-        std::get<T_FirstComponent*>(entity->_components) = &componentVector[entity->_id];
-        if constexpr (sizeof...(T_RestComponents) > 0)
-            constructComponent<T_Entity, T_RestComponents...>(entity);
+        EntityId id = allocateEntityId();
+        addRow<T_EntityComponents...>(id);
+        return id;
     }
 
-    template <typename T_Entity, typename T_FirstComponent, typename... T_RestComponents>
-    void copyComponent(const T_Entity& oldEntity, T_Entity* newEntity)
+    // Base entity for an id allocated with allocateRow. Only reads the pool, so entities with
+    // different ids can be attached concurrently.
+    template <typename... T_EntityComponents>
+    Entity<T_EntityComponents...> attachEntity(Entity<T_EntityComponents...>* dummy, EntityId id) // dummy needed for component type deduction
     {
-        auto& componentVector = std::get<std::vector<T_FirstComponent>>(_components);
-        std::get<T_FirstComponent*>(newEntity->_components) = &componentVector[newEntity->_id];
-        componentVector[newEntity->_id] = *std::get<T_FirstComponent*>(oldEntity._components);
-        if constexpr (sizeof...(T_RestComponents) > 0)
-            copyComponent<T_Entity, T_RestComponents...>(oldEntity, newEntity);
+        return attachEntity<T_EntityComponents...>(id);
     }
 
-    void resizeComponentStorage(std::size_t size)
+    template <typename... T_EntityComponents>
+    Entity<T_EntityComponents...> attachEntity(EntityId id)
     {
-        // Resize all component vectors
-        std::apply([size](auto&&... components) {((components.resize(size)), ...);}, _components);
+        auto entity = Entity<T_EntityComponents...>(this, id);
+        moveComponents<Entity<T_EntityComponents...>, T_EntityComponents...>(&entity);
+        return entity;
+    }
 
-        for (EntityId id=0; id<_entityHandles.size(); ++id) {
-            if (_entityHandles[id] == nullptr)
-                continue;
+    template <typename T_Container>
+    static void reserveGrowth(T_Container& container, std::size_t size)
+    {
+        // Grow geometrically so that repeated small reservations stay amortized O(1)
+        if (size > container.capacity())
+            container.reserve(std::max(size, 2*container.capacity()));
+    }
 
-            if (_componentMovers[id] == nullptr) {
-                std::runtime_error("_componentMovers[" + std::to_string(id) + "] is nullptr when resizing component storage. This is indicates a bug in ComponentPool implementation");
-            }
+    template <typename... T_EntityComponents>
+    void reserveRows(Entity<T_EntityComponents...>* dummy, std::size_t count) // dummy needed for component type deduction
+    {
+        auto& archetype = _archetypes[findArchetype(componentMask<T_EntityComponents...>())];
+        std::size_t nRows = archetype.entityIds.size() + count;
+        reserveGrowth(archetype.entityIds, nRows);
+        (std::get<ChunkedVector<T_EntityComponents>>(archetype.components).reserve(nRows), ...);
+    }
+
+    // Append a row of default constructed components for entityId to the archetype of T_EntityComponents
+    template <typename... T_EntityComponents>
+    void addRow(EntityId entityId)
+    {
+        constexpr auto mask = componentMask<T_EntityComponents...>();
+        std::size_t archetypeId = findArchetype(mask);
+        auto& archetype = _archetypes[archetypeId];
+
+        EntityId index = entityIndex(entityId);
+        _entityLocations[index] = {archetypeId, archetype.entityIds.size()};
+        _componentMovers[index] = &ComponentPool<T_Components...>::moveComponents<T_EntityComponents...>;
+        archetype.entityIds.push_back(entityId);
+        (std::get<ChunkedVector<T_EntityComponents>>(archetype.components).emplace_back(), ...);
+    }
 
-            // Reassign all entity component pointers to point to (potentially) new component locations
-            (this->*_componentMovers[id])(_entityHandles[id]);
+    std::size_t findArchetype(uint64_t mask)
+    {
+        // There's an archetype per entity type so linear search is sufficient
+        for (std::size_t i=0; i<_archetypes.size(); ++i) {
+            if (_archetypes[i].mask == mask)
+                return i;
         }
+
+        _archetypes.emplace_back();
+        _archetypes.back().mask = mask;
+        return _archetypes.size()-1;
     }
 
     template <typename... T_EntityComponents>
@@ -171,8 +400,7 @@ private:
     template <typename T_Entity, typename T_FirstComponent, typename... T_RestComponents>
     inline void moveComponents(T_Entity* entity)
     {
-        std::get<T_FirstComponent*>(entity->_components) =
-            &std::get<std::vector<T_FirstComponent>>(_components)[entity->_id];
+        std::get<T_FirstComponent*>(entity->_components) = &getComponent<T_FirstComponent>(entity->_id);
 
         if constexpr (sizeof...(T_RestComponents) > 0)
             moveComponents<T_Entity, T_RestComponents...>(entity);
@@ -195,8 +423,10 @@ private:
     using ComponentMover = void(ComponentPool<T_Components...>::*)(void*);
 
     std::vector<void*>                          _entityHandles;
-    std::vector<uint64_t>                       _componentMasks;
+    std::vector<EntityLocation>                 _entityLocations;
     std::vector<ComponentMover>                 _componentMovers;
-    std::tuple<std::vector<T_Components>...>    _components;
+    std::vector<uint32_t>                       _generations;
+    std::vector<EntityId>                       _freeIndices;
+    std::vector<Archetype>                      _archetypes;
     int64_t                                     _nRunningSystems;
 };
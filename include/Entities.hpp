@@ -13,8 +13,9 @@
 #include "TypeId.hpp"
 
 
-// List all Entities here, remember also to add forward declaration below
+// List all Entities here, remember also to add forward declaration and name below
 #define ENTITY_TYPES NPC, Food
+#define ENTITY_TYPE_NAMES "NPC", "Food"
 
 
 class NPC;
@@ -26,3 +27,11 @@ consteval TypeId entityTypeId()
 {
     return TypeIdGenerator<ENTITY_TYPES>::typeId<T_Entity>();
 }
+
+template <typename T_Entity>
+constexpr const char* entityTypeName()
+{
+    constexpr const char* names[] = { ENTITY_TYPE_NAMES };
+    static_assert(sizeof(names)/sizeof(names[0]) == N_ENTITY_TYPES, "ENTITY_TYPE_NAMES does not match ENTITY_TYPES");
+    return names[entityTypeId<T_Entity>()];
+}
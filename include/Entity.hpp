@@ -10,6 +10,7 @@
 
 #pragma once
 
+#include <cstdint>
 #include <vector>
 #include <tuple>
 
@@ -22,8 +23,25 @@
 template <typename... T_Components>
 class ComponentPool;
 
+// Entity ids consist of a slot index (lower 32 bits) and a generation counter (upper 32 bits) that is
+// incremented every time the slot is freed, so that ids of destroyed entities never alias new ones
 using EntityId = std::vector<void*>::size_type;
 
+constexpr EntityId entityIndex(EntityId id)
+{
+    return id & 0x00000000ffffffff;
+}
+
+constexpr uint32_t entityGeneration(EntityId id)
+{
+    return (uint32_t)(id >> 32);
+}
+
+constexpr EntityId makeEntityId(EntityId index, uint32_t generation)
+{
+    return ((EntityId)generation << 32) | index;
+}
+
 
 template <typename... T_Components>
 class Entity {
@@ -50,7 +68,8 @@ public:
     {
     }
 
-    Entity(Entity&& other) :
+    // noexcept so that containers of entities move instead of copy them when reallocating
+    Entity(Entity&& other) noexcept :
         _pool       (other._pool),
         _id         (other._id),
         _components (other._components),
@@ -0,0 +1,55 @@
+//
+// Project: rpg_world_simulator
+// File: EntityCommandBuffer.hpp
+//
+// Copyright (c) 2024 Miika 'Lehdari' Lehtimäki
+// You may use, distribute and modify this code under the terms
+// of the licence specified in file LICENSE which is distributed
+// with this source code package.
+//
+
+#pragma once
+
+#include "Entity.hpp"
+
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <vector>
+
+
+// Queue for entity creation and removal requested while systems, update loops and collision
+// callbacks are running. World applies the queued changes at sync points. Queueing and the
+// isRemoved query are thread safe.
+class EntityCommandBuffer {
+public:
+    // Queue removal of an entity, removing the same entity more than once is allowed. The id must
+    // belong to a live entity, stale ids are to be filtered out by the caller.
+    void remove(EntityId id);
+    // Queue a function creating entities
+    void create(std::function<void()>&& creator);
+
+    // Check whether the entity has been queued for removal, the full id including the generation
+    // is compared so that a stale id does not match the entity currently in its slot
+    bool isRemoved(EntityId id) const;
+    // Entities queued for removal, in queueing order unless sorted
+    const std::vector<EntityId>& getRemoved() const;
+    // Sort the queued removals by id, must not be called concurrently with the other functions
+    void sortRemoved();
+
+    // Run the queued creators and clear the buffer, removals need to be applied before calling this
+    void apply();
+
+    // Make room for the removal state of nEntitySlots entity slots, must not be called concurrently
+    // with the other functions
+    void reserve(std::size_t nEntitySlots);
+
+private:
+    static constexpr EntityId notRemoved = (EntityId)-1;
+
+    std::vector<EntityId>               _removedIds; // per entity index or notRemoved, accessed atomically
+    std::vector<EntityId>               _removed;
+    std::vector<std::function<void()>>  _creators;
+    std::mutex                          _mutex;
+};
@@ -0,0 +1,107 @@
+//
+// Project: rpg_world_simulator
+// File: EntityContainer.hpp
+//
+// Copyright (c) 2024 Miika 'Lehdari' Lehtimäki
+// You may use, distribute and modify this code under the terms
+// of the licence specified in file LICENSE which is distributed
+// with this source code package.
+//
+
+#pragma once
+
+#include "Entity.hpp"
+
+#include <cstdint>
+#include <limits>
+#include <tuple>
+#include <vector>
+
+
+// Container for entities of a single type. Entities are stored contiguously and can be found
+// and removed by EntityId in O(1) through a back-index. Removal moves the last entity in place of
+// the removed one, so the order of the entities is not preserved.
+template <typename T_Entity>
+class EntityContainer {
+public:
+    using Iterator = typename std::vector<T_Entity>::iterator;
+
+    template <typename... T_Args>
+    T_Entity& emplace_back(T_Args&&... args)
+    {
+        auto& entity = _entities.emplace_back(std::forward<T_Args>(args)...);
+        EntityId index = entityIndex(entity.entityId());
+        if (index >= _positions.size())
+            _positions.resize(index+1, invalidPosition);
+        _positions[index] = _entities.size()-1;
+        return entity;
+    }
+
+    // Returns false if the entity is not in the container
+    bool remove(EntityId id)
+    {
+        T_Entity* entity = find(id);
+        if (entity == nullptr)
+            return false;
+
+        std::size_t position = entity - _entities.data();
+        _positions[entityIndex(id)] = invalidPosition;
+        if (position != _entities.size()-1) {
+            *entity = std::move(_entities.back()); // destroys the removed entity
+            _positions[entityIndex(entity->entityId())] = position;
+        }
+        _entities.pop_back();
+        return true;
+    }
+
+    // Returns nullptr if the entity is not in the container
+    T_Entity* find(EntityId id)
+    {
+        EntityId index = entityIndex(id);
+        if (index >= _positions.size() || _positions[index] == invalidPosition)
+            return nullptr;
+
+        auto& entity = _entities[_positions[index]];
+        return entity.entityId() == id ? &entity : nullptr;
+    }
+
+    void reserve(std::size_t capacity)
+    {
+        _entities.reserve(capacity);
+    }
+
+    std::size_t capacity() const
+    {
+        return _entities.capacity();
+    }
+
+    std::size_t size() const
+    {
+        return _entities.size();
+    }
+
+    T_Entity& operator[](std::size_t i)
+    {
+        return _entities[i];
+    }
+
+    Iterator begin()
+    {
+        return _entities.begin();
+    }
+
+    Iterator end()
+    {
+        return _entities.end();
+    }
+
+private:
+    static constexpr uint32_t   invalidPosition = std::numeric_limits<uint32_t>::max();
+
+    std::vector<T_Entity>       _entities;
+    std::vector<uint32_t>       _positions; // position in _entities per entity index
+};
+
+
+template <typename... T_Entities>
+using EntityContainers = std::tuple<EntityContainer<T_Entities>...>;
@@ -21,9 +21,21 @@ class Orientation;
 
 
 struct EntityFinder {
+    // Thread local part of the system for ComponentPool::runSystemParallel
+    struct Worker {
+        Vec2f                                       point;
+        double                                      radius;
+        std::vector<std::pair<EntityId, TypeId>>    entityHandles;
+
+        Worker(const EntityFinder& entityFinder);
+
+        void operator()(EntityId id, Label& label, Orientation& orientation);
+    };
+
     Vec2f                                       point           {0.0f, 0.0f};
     double                                      radius          {0.0};
     std::vector<std::pair<EntityId, TypeId>>*   entityHandles   {nullptr};
 
     void operator()(EntityId id, Label& label, Orientation& orientation);
+    void merge(Worker& worker);
 };
\ No newline at end of file
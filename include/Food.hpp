@@ -15,6 +15,7 @@
 #include "Sprite.hpp"
 #include "CollisionBody.hpp"
 #include "Entity.hpp"
+#include "Random.hpp"
 
 
 class World;
@@ -22,9 +23,11 @@ class World;
 
 class Food : public Entity<Label, Orientation, Sprite, CollisionBody> {
 public:
-    Food(EntityType&& entity, const Vec2f& position);
+    // Initial state is drawn from the creation stream of the entity in the world with the seed at tick
+    Food(EntityType&& entity, const Vec2f& position, uint64_t seed, uint64_t tick);
 
-    void update(World* world);
+    // growth is the random increase of the nutritional value, drawn for the whole update pass
+    void update(World* world, float growth);
     void updateRadius();
 
     friend class CollisionHandler;
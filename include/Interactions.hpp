@@ -0,0 +1,31 @@
+//
+// Project: rpg_world_simulator
+// File: Interactions.hpp
+//
+// Copyright (c) 2024 Miika 'Lehdari' Lehtimäki
+// You may use, distribute and modify this code under the terms
+// of the licence specified in file LICENSE which is distributed
+// with this source code package.
+//
+
+#pragma once
+
+#include "Entity.hpp"
+
+#include <vector>
+
+
+// Intents of interactions between entities recorded by collision handlers. Intents are resolved
+// and committed by CollisionHandler once all collisions have been handled, so the outcome does
+// not depend on the order of the collisions. Each chunk of collisions records into its own
+// buffer, allowing the chunks to be handled concurrently.
+struct Interactions {
+    struct Eat {
+        EntityId    npcId;
+        EntityId    foodId;
+    };
+
+    std::vector<Eat>    eats;
+
+    void clear();
+};
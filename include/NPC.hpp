@@ -15,16 +15,17 @@
 #include "Sprite.hpp"
 #include "CollisionBody.hpp"
 #include "Entity.hpp"
+#include "Random.hpp"
 
 
-class SpriteRenderer;
 class World;
 class Food;
 
 
 class NPC : public Entity<Label, Orientation, Sprite, CollisionBody> {
 public:
-    NPC(EntityType&& entity, const Vec2f& position);
+    // Initial state is drawn from the creation stream of the entity in the world with the seed at tick
+    NPC(EntityType&& entity, const Vec2f& position, uint64_t seed, uint64_t tick);
 
     void update(World* world);
 
@@ -32,7 +33,7 @@ public:
 
 private:
     double  _speed;
-    Vec2f   _velocity; // computed from orientation and _speed
+    Vec2f   _velocity; // computed from orientation and _speed, zero until the first update
 
     double  _health;
     double  _maxEnergy;
@@ -43,3 +43,7 @@ private:
 
     void updateOrientation();
 };
+
+
+// Orientation between from (alpha = 0) and to (alpha = 1), rotation is interpolated the shorter way around
+Orientation interpolate(const Orientation& from, const Orientation& to, float alpha);
@@ -0,0 +1,36 @@
+//
+// Project: rpg_world_simulator
+// File: OrientationHistory.hpp
+//
+// Copyright (c) 2024 Miika 'Lehdari' Lehtimäki
+// You may use, distribute and modify this code under the terms
+// of the licence specified in file LICENSE which is distributed
+// with this source code package.
+//
+
+#pragma once
+
+#include "Entity.hpp"
+#include "Orientation.hpp"
+
+#include <vector>
+
+
+// Orientations of all entities recorded before a tick, for interpolating rendered orientations
+// between the last two ticks. Recorded by running it as a system over Orientation components.
+class OrientationHistory {
+public:
+    void operator()(EntityId id, Orientation& orientation);
+
+    // Recorded orientation of an entity, current for entities without one (such as the ones
+    // created during the tick)
+    const Orientation& getRecorded(EntityId id, const Orientation& current) const;
+
+private:
+    struct Entry {
+        EntityId    id;
+        Orientation orientation;
+    };
+
+    std::vector<Entry>  _entries; // per entity index
+};
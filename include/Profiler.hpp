@@ -0,0 +1,89 @@
+//
+// Project: rpg_world_simulator
+// File: Profiler.hpp
+//
+// Copyright (c) 2024 Miika 'Lehdari' Lehtimäki
+// You may use, distribute and modify this code under the terms
+// of the licence specified in file LICENSE which is distributed
+// with this source code package.
+//
+
+#pragma once
+
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <vector>
+
+
+// Rolling timing statistics of named stages. Stages are timed with the PROFILE_SCOPE macro, which
+// compiles to nothing unless RPG_WORLD_SIMULATOR_PROFILING is defined.
+class Profiler {
+public:
+    using StageId = std::size_t;
+    using Clock = std::chrono::steady_clock;
+
+    static constexpr std::size_t historySize = 256;
+
+    struct StageStatistics {
+        std::string             name;
+        std::vector<float>      durations;  // milliseconds, oldest first
+        float                   p50;
+        float                   p99;
+    };
+
+    static Profiler& instance();
+
+    // Returns the id of an existing stage with the same name if there is one
+    StageId addStage(const std::string& name);
+    void addSample(StageId stageId, Clock::duration duration);
+
+    std::vector<StageStatistics> getStatistics() const;
+
+private:
+    struct Stage {
+        std::string                         name;
+        std::array<float, historySize>      durations; // ring buffer
+        std::size_t                         nSamples;
+    };
+
+    std::vector<Stage>  _stages;
+    mutable std::mutex  _mutex;
+};
+
+
+class ScopedTimer {
+public:
+    ScopedTimer(Profiler::StageId stageId) :
+        _stageId    (stageId),
+        _start      (Profiler::Clock::now())
+    {
+    }
+
+    ScopedTimer(const ScopedTimer&) = delete;
+    ScopedTimer& operator=(const ScopedTimer&) = delete;
+
+    ~ScopedTimer()
+    {
+        Profiler::instance().addSample(_stageId, Profiler::Clock::now() - _start);
+    }
+
+private:
+    Profiler::StageId               _stageId;
+    Profiler::Clock::time_point     _start;
+};
+
+
+#define PROFILE_CONCAT_INNER(A, B) A##B
+#define PROFILE_CONCAT(A, B) PROFILE_CONCAT_INNER(A, B)
+
+#ifdef RPG_WORLD_SIMULATOR_PROFILING
+// Time the rest of the enclosing scope as stage NAME
+#define PROFILE_SCOPE(NAME) \
+    static const Profiler::StageId PROFILE_CONCAT(profileStageId, __LINE__) = Profiler::instance().addStage(NAME); \
+    ScopedTimer PROFILE_CONCAT(profileTimer, __LINE__)(PROFILE_CONCAT(profileStageId, __LINE__))
+#else
+#define PROFILE_SCOPE(NAME)
+#endif
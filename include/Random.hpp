@@ -0,0 +1,56 @@
+//
+// Project: rpg_world_simulator
+// File: Random.hpp
+//
+// Copyright (c) 2024 Miika 'Lehdari' Lehtimäki
+// You may use, distribute and modify this code under the terms
+// of the licence specified in file LICENSE which is distributed
+// with this source code package.
+//
+
+#pragma once
+
+#include "Entity.hpp"
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+
+
+// Counter-based random number stream (Philox4x32-10). A stream is keyed by world seed, tick,
+// entity id and a stream index separating independent uses within the same tick, so the numbers
+// drawn do not depend on the order or the thread the entities are updated in. Streams are cheap
+// to create and are meant to be created where needed, e.g. one per entity update.
+class Random {
+public:
+    enum Stream : uint32_t {
+        Create  = 0,
+        Update  = 1,
+        Spawn   = 2
+    };
+
+    // Id for streams not belonging to any entity
+    static constexpr EntityId worldId = (EntityId)-1;
+
+    Random(uint64_t seed, uint64_t tick, EntityId id, uint32_t stream);
+
+    uint32_t next();
+
+    // Uniform in [min, max)
+    float uniform(float min, float max);
+    double uniform(double min, double max);
+
+    // Fill out with the first number of the stream of each id in ids, uniform in [min, max).
+    // out[i] equals Random(seed, tick, ids[i], stream).uniform(min, max). Computed in lanes
+    // suitable for vectorization, for generating the numbers of a whole system pass at once.
+    static void uniformBatch(uint64_t seed, uint64_t tick, uint32_t stream, const EntityId* ids,
+        std::size_t count, float min, float max, float* out);
+
+private:
+    using Block = std::array<uint32_t, 4>;
+
+    std::array<uint32_t, 2> _key;
+    Block                   _counter;
+    Block                   _block;
+    uint32_t                _blockPosition; // next number in _block, 4 when exhausted
+};
@@ -0,0 +1,203 @@
+//
+// Project: rpg_world_simulator
+// File: RenderSnapshot.hpp
+//
+// Copyright (c) 2024 Miika 'Lehdari' Lehtimäki
+// You may use, distribute and modify this code under the terms
+// of the licence specified in file LICENSE which is distributed
+// with this source code package.
+//
+
+#pragma once
+
+#include "Entity.hpp"
+#include "Sprite.hpp"
+#include "Orientation.hpp"
+
+#include <gut_utils/MathTypes.hpp>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <vector>
+
+
+class OrientationHistory;
+
+
+// Copy of the renderable state of the world after a tick. The instances are sorted into a uniform
+// grid by their current positions for culling them against the visible area. Instances with
+// non-finite positions are left out. The grid spans at most maxGridSize cells per axis, instances
+// outside it are kept in an overflow list that is culled separately and not aggregated.
+class RenderSnapshot {
+public:
+    using Clock = std::chrono::steady_clock;
+
+    static constexpr int32_t maxGridSize = 4096;
+
+    struct Instance {
+        Sprite      sprite;
+        Orientation previous;   // before the tick
+        Orientation current;    // after the tick
+    };
+
+    // Summary of the instances of a grid cell for aggregated rendering
+    struct CellAggregate {
+        Vec3f   color;      // mean sprite color
+        float   spriteArea; // total sprite area in world units per square pixel of sprite
+    };
+
+    // Inclusive range of grid cells
+    struct CellRange {
+        int32_t x1;
+        int32_t y1;
+        int32_t x2;
+        int32_t y2;
+    };
+
+    RenderSnapshot(float cellSize = 4.0f);
+
+    // Discard all instances, call before adding the instances of a tick
+    void clear();
+    void add(const Sprite& sprite, const Orientation& previous, const Orientation& current);
+    // Sort the added instances into cells, call after adding all instances
+    void build();
+
+    // Call visitor(const Instance&) for the instances whose current position lies within the
+    // rectangle [min, max] grown by margin on all sides
+    template <typename T_Visitor>
+    void forEachInRectangle(const Vec2f& min, const Vec2f& max, float margin, T_Visitor&& visitor) const;
+
+    // Grid cells overlapping the rectangle [min, max], returns false if there are none
+    bool getCellRange(const Vec2f& min, const Vec2f& max, CellRange& range) const;
+    const CellAggregate& getCellAggregate(int32_t x, int32_t y) const;
+    // World space minimum corner of a cell
+    Vec2f getCellMin(int32_t x, int32_t y) const;
+    float getCellSize() const;
+
+    // Largest orientation scale times sprite scale, sprites are at most this times their size in
+    // pixels large in world units
+    float getMaxSpriteScale() const;
+
+    // Upper bound for the distance from the current position of an instance to any point of its
+    // rendered sprite at any interpolation factor. maxSpriteDiagonal is the largest sprite diagonal
+    // in pixels.
+    float getBoundingRadius(float maxSpriteDiagonal) const;
+
+    // Interpolation factor from previous to current orientations at time, reaching 1 one tick
+    // after publishing
+    float getInterpolationAlpha(Clock::time_point time) const;
+
+    Clock::time_point       publishTime;
+    double                  tickTime    {0.0}; // seconds
+
+private:
+    float                       _cellSize;
+    float                       _cellSizeInv;
+
+    // Grid bounds in cell coordinates
+    int32_t                     _xMin;
+    int32_t                     _yMin;
+    int32_t                     _width;
+    int32_t                     _height;
+
+    std::vector<Instance>       _added;
+    std::vector<uint32_t>       _addedCells;
+    std::vector<int32_t>        _addedCoordinates;
+    std::vector<uint32_t>       _cellFill;
+    std::vector<Instance>       _instances;     // sorted by cell
+    std::vector<uint32_t>       _cellStarts;    // index of first instance of each cell, size nCells+1
+    std::vector<CellAggregate>  _cellAggregates;
+    std::vector<Instance>       _overflow;      // instances outside the grid
+
+    // Bounds of the sprite extents, for getBoundingRadius
+    float                       _maxScale;          // orientation scale times sprite scale
+    float                       _maxOrigin;         // pixels
+    float                       _maxDisplacement;   // from previous to current position
+
+    // Cell coordinate of x, clamped so that it stays representable for any x
+    int32_t cellCoordinate(float x) const;
+    // Fit the grid along one axis to the cell coordinates of the added instances
+    void fitAxis(std::vector<int32_t>& coordinates, int32_t& min, int32_t& size) const;
+};
+
+
+// System filling a snapshot from the Sprite and Orientation components, previous orientations
+// are taken from the history recorded before the tick
+class RenderSnapshotWriter {
+public:
+    RenderSnapshotWriter(RenderSnapshot* snapshot, const OrientationHistory* orientationHistory);
+
+    void operator()(EntityId id, Sprite& sprite, Orientation& orientation);
+
+private:
+    RenderSnapshot*             _snapshot;
+    const OrientationHistory*   _orientationHistory;
+};
+
+
+// Lock-free triple buffer for passing snapshots from a single producer to a single consumer.
+// The producer always has a snapshot to write to and the consumer always has the latest
+// published snapshot to read from, neither ever waits for the other.
+class RenderSnapshotBuffer {
+public:
+    RenderSnapshotBuffer();
+
+    RenderSnapshotBuffer(const RenderSnapshotBuffer&) = delete;
+    RenderSnapshotBuffer& operator=(const RenderSnapshotBuffer&) = delete;
+
+    // Producer: snapshot to fill, contains stale data from an earlier publish
+    RenderSnapshot& getWriteSnapshot();
+    // Producer: make the write snapshot the latest one
+    void publish();
+
+    // Consumer: latest published snapshot, owned by the consumer until the next call
+    RenderSnapshot& acquire();
+
+private:
+    static constexpr uint8_t indexMask  = 0x3;
+    static constexpr uint8_t freshBit   = 0x4; // set on publish, cleared on acquire
+
+    RenderSnapshot          _snapshots[3];
+    uint8_t                 _write; // producer only
+    uint8_t                 _read;  // consumer only
+    std::atomic<uint8_t>    _middle;
+};
+
+
+template <typename T_Visitor>
+void RenderSnapshot::forEachInRectangle(
+    const Vec2f& min, const Vec2f& max, float margin, T_Visitor&& visitor) const
+{
+    Vec2f grownMin = min - Vec2f(margin, margin);
+    Vec2f grownMax = max + Vec2f(margin, margin);
+    for (const auto& instance : _overflow) {
+        const auto& p = instance.current.getPosition();
+        if (p(0) >= grownMin(0) && p(0) <= grownMax(0) && p(1) >= grownMin(1) && p(1) <= grownMax(1))
+            visitor(instance);
+    }
+
+    if (_instances.empty())
+        return;
+
+    int32_t x1 = std::max(cellCoordinate(grownMin(0)) - _xMin, 0);
+    int32_t x2 = std::min(cellCoordinate(grownMax(0)) - _xMin, _width-1);
+    int32_t y1 = std::max(cellCoordinate(grownMin(1)) - _yMin, 0);
+    int32_t y2 = std::min(cellCoordinate(grownMax(1)) - _yMin, _height-1);
+    if (x1 > x2 || y1 > y2)
+        return;
+
+    for (int32_t y=y1; y<=y2; ++y) {
+        // Instances of horizontally adjacent cells are contiguous
+        uint32_t begin = _cellStarts[y*_width + x1];
+        uint32_t end = _cellStarts[y*_width + x2 + 1];
+        for (uint32_t i=begin; i<end; ++i) {
+            const auto& instance = _instances[i];
+            const auto& p = instance.current.getPosition();
+            if (p(0) >= grownMin(0) && p(0) <= grownMax(0) && p(1) >= grownMin(1) && p(1) <= grownMax(1))
+                visitor(instance);
+        }
+    }
+}
@@ -0,0 +1,85 @@
+//
+// Project: rpg_world_simulator
+// File: Simulation.hpp
+//
+// Copyright (c) 2024 Miika 'Lehdari' Lehtimäki
+// You may use, distribute and modify this code under the terms
+// of the licence specified in file LICENSE which is distributed
+// with this source code package.
+//
+
+#pragma once
+
+#include "Components.hpp"
+#include "ComponentPool.hpp"
+#include "CollisionHandler.hpp"
+#include "OrientationHistory.hpp"
+#include "RenderSnapshot.hpp"
+#include "World.hpp"
+
+#include <atomic>
+#include <chrono>
+#include <thread>
+
+
+// Runs the world on a dedicated thread at a fixed tick rate and publishes a render snapshot
+// after every tick. The controls are safe to call from any thread.
+class Simulation {
+public:
+    using Clock = std::chrono::steady_clock;
+
+    // Backlog of ticks due exceeding this is dropped instead of trying to catch up
+    static constexpr double maxBacklog = 0.25; // seconds
+
+    Simulation();
+
+    Simulation(const Simulation&) = delete;
+    Simulation(Simulation&&) = delete;
+    Simulation& operator=(const Simulation&) = delete;
+    Simulation& operator=(Simulation&&) = delete;
+
+    ~Simulation();
+
+    void start();
+    void stop();
+
+    void setPaused(bool paused);
+    bool isPaused() const;
+    void setTicksPerSecond(double ticksPerSecond);
+    double getTicksPerSecond() const;
+    double getAchievedTicksPerSecond() const;
+    // Switch between World::UpdateMode::Parallel and Serial, applied from the next tick on
+    void setParallelUpdates(bool parallelUpdates);
+    bool getParallelUpdates() const;
+
+    // Capture a Chrome trace of the next nTicks ticks to traceFileName, requires tracing
+    // to be enabled at compile time
+    void captureTrace(int nTicks);
+    int getTraceTicksLeft() const;
+
+    // Snapshots are consumed by a single (render) thread
+    RenderSnapshotBuffer& getRenderSnapshots();
+
+    static constexpr const char* traceFileName = "trace.json";
+
+private:
+    ComponentPool<COMPONENT_TYPES>  _componentPool;
+    World                           _world;
+    CollisionHandler                _collisionHandler;
+    OrientationHistory              _orientationHistory;
+    RenderSnapshotBuffer            _renderSnapshots;
+
+    std::thread                     _thread;
+    std::atomic<bool>               _quit;
+    std::atomic<bool>               _paused;
+    std::atomic<double>             _ticksPerSecond; // target rate
+    std::atomic<double>             _achievedTicksPerSecond;
+    std::atomic<bool>               _parallelUpdates;
+    std::atomic<int>                _traceTicksRequested;
+    std::atomic<int>                _traceTicksLeft;
+
+    void run();
+    // Update the world and publish a snapshot of it
+    void tick(double tickTime);
+    void updateTrace();
+};
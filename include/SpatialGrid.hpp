@@ -0,0 +1,184 @@
+//
+// Project: rpg_world_simulator
+// File: SpatialGrid.hpp
+//
+// Copyright (c) 2024 Miika 'Lehdari' Lehtimäki
+// You may use, distribute and modify this code under the terms
+// of the licence specified in file LICENSE which is distributed
+// with this source code package.
+//
+
+#pragma once
+
+#include "Entity.hpp"
+#include "Entities.hpp"
+
+#include <gut_utils/MathTypes.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <vector>
+
+
+class Label;
+class Orientation;
+
+
+// Uniform grid cache of entity positions for efficient spatial queries. The grid is filled by
+// running it as a system over Label and Orientation components, after which build() sorts the
+// gathered entities into cells. Positions are snapshots taken at the time of gathering. Entities
+// with non-finite positions are left out, and the grid spans at most maxGridSize cells per axis
+// so that far away entities cannot blow up its size. Entries outside the grid are kept in an
+// overflow list that every query checks.
+class SpatialGrid {
+public:
+    struct Entry {
+        EntityId    id;
+        TypeId      entityTypeId;
+        Vec2f       position;
+    };
+
+    static constexpr int32_t maxGridSize = 4096;
+
+    SpatialGrid(float cellSize = 1.0f);
+
+    void setCellSize(float cellSize);
+    float getCellSize() const;
+
+    // Discard all entries, call before running the grid as a system
+    void clear();
+
+    void operator()(EntityId id, Label& label, Orientation& orientation);
+
+    // Sort the gathered entries into cells, call after running the grid as a system
+    void build();
+
+    // Call visitor(const Entry&) for all entries within radius of point
+    template <typename T_Visitor>
+    void forEachWithinRadius(const Vec2f& point, float radius, T_Visitor&& visitor) const;
+
+    // Find the entry nearest to point within maxRadius for which predicate(const Entry&) returns
+    // true. Cells are searched in rings of increasing distance and the search stops once no closer
+    // entry is possible. Returns nullptr if no such entry exists.
+    template <typename T_Predicate>
+    const Entry* findNearest(const Vec2f& point, float maxRadius, T_Predicate&& predicate) const;
+
+    std::size_t size() const;
+
+private:
+    float                       _cellSize;
+    float                       _cellSizeInv;
+
+    // Grid bounds in cell coordinates
+    int32_t                     _xMin;
+    int32_t                     _yMin;
+    int32_t                     _width;
+    int32_t                     _height;
+
+    std::vector<Entry>          _gathered;
+    std::vector<uint32_t>       _gatheredCells;
+    std::vector<int32_t>        _gatheredCoordinates;
+    std::vector<uint32_t>       _cellFill;
+    std::vector<Entry>          _entries;       // sorted by cell
+    std::vector<uint32_t>       _cellStarts;    // index of first entry of each cell in _entries, size nCells+1
+    std::vector<Entry>          _overflow;      // entries outside the grid
+
+    // Cell coordinate of x, clamped so that it stays representable for any x
+    int32_t cellCoordinate(float x) const;
+    // Fit the grid along one axis to the cell coordinates of the gathered entries
+    void fitAxis(std::vector<int32_t>& coordinates, int32_t& min, int32_t& size) const;
+};
+
+
+template <typename T_Visitor>
+void SpatialGrid::forEachWithinRadius(const Vec2f& point, float radius, T_Visitor&& visitor) const
+{
+    float radiusSqr = radius*radius;
+    for (const auto& entry : _overflow) {
+        if ((entry.position-point).squaredNorm() <= radiusSqr)
+            visitor(entry);
+    }
+
+    if (_entries.empty())
+        return;
+
+    int32_t x1 = std::max(cellCoordinate(point(0)-radius) - _xMin, 0);
+    int32_t x2 = std::min(cellCoordinate(point(0)+radius) - _xMin, _width-1);
+    int32_t y1 = std::max(cellCoordinate(point(1)-radius) - _yMin, 0);
+    int32_t y2 = std::min(cellCoordinate(point(1)+radius) - _yMin, _height-1);
+    if (x1 > x2 || y1 > y2)
+        return;
+
+    for (int32_t y=y1; y<=y2; ++y) {
+        // Entries of horizontally adjacent cells are contiguous
+        uint32_t begin = _cellStarts[y*_width + x1];
+        uint32_t end = _cellStarts[y*_width + x2 + 1];
+        for (uint32_t i=begin; i<end; ++i) {
+            const auto& entry = _entries[i];
+            if ((entry.position-point).squaredNorm() <= radiusSqr)
+                visitor(entry);
+        }
+    }
+}
+
+template <typename T_Predicate>
+const SpatialGrid::Entry* SpatialGrid::findNearest(const Vec2f& point, float maxRadius,
+    T_Predicate&& predicate) const
+{
+    const Entry* nearest = nullptr;
+    float nearestDistanceSqr = maxRadius*maxRadius;
+
+    for (const auto& entry : _overflow) {
+        float distanceSqr = (entry.position-point).squaredNorm();
+        if (distanceSqr <= nearestDistanceSqr && predicate(entry)) {
+            nearest = &entry;
+            nearestDistanceSqr = distanceSqr;
+        }
+    }
+
+    if (_entries.empty())
+        return nearest;
+
+    // Check the cells x1...x2 on row y, clipped to the grid
+    auto searchRow = [&](int32_t y, int32_t x1, int32_t x2) {
+        if (y < 0 || y >= _height)
+            return;
+        x1 = std::max(x1, 0);
+        x2 = std::min(x2, _width-1);
+        if (x1 > x2)
+            return;
+        uint32_t end = _cellStarts[y*_width + x2 + 1];
+        for (uint32_t i=_cellStarts[y*_width + x1]; i<end; ++i) {
+            const auto& entry = _entries[i];
+            float distanceSqr = (entry.position-point).squaredNorm();
+            if (distanceSqr <= nearestDistanceSqr && predicate(entry)) {
+                nearest = &entry;
+                nearestDistanceSqr = distanceSqr;
+            }
+        }
+    };
+
+    int32_t cx = cellCoordinate(point(0)) - _xMin;
+    int32_t cy = cellCoordinate(point(1)) - _yMin;
+    for (int32_t r=0;; ++r) {
+        // Entries outside rings 0...r-1 are at least (r-1)*_cellSize away from point
+        float minDistance = std::max(r-1, 0)*_cellSize;
+        if (minDistance*minDistance > nearestDistanceSqr)
+            break;
+        // Ring r lies completely outside the grid
+        if (cx-r < 0 && cx+r >= _width && cy-r < 0 && cy+r >= _height)
+            break;
+
+        searchRow(cy-r, cx-r, cx+r);
+        if (r == 0)
+            continue;
+        searchRow(cy+r, cx-r, cx+r);
+        for (int32_t y=std::max(cy-r+1, 0); y<std::min(cy+r, _height); ++y) {
+            searchRow(y, cx-r, cx-r);
+            searchRow(y, cx+r, cx+r);
+        }
+    }
+
+    return nearest;
+}
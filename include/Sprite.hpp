@@ -11,14 +11,17 @@
 #pragma once
 
 
-#include "SpriteSheet.hpp"
-
 #include <gut_utils/MathUtils.hpp>
 
+#include <cstddef>
+
 
 class SpriteRenderer;
 
 
+using SpriteSheetId = std::size_t;
+
+
 class Sprite {
 public:
     Sprite(SpriteSheetId sheetId = 0, int spriteId = 0);
@@ -35,18 +38,12 @@ public:
     const Vec3f& getColor() const;
     const Vec2f& getScale() const;
 
-    // Updates changes made and cleans dirty flag, should be called before rendering
-    void update(const SpriteRenderer& renderer);
-
     friend class SpriteRenderer;
 
 private:
-    bool            _dirty;
     SpriteSheetId   _spriteSheetId;
     int             _spriteId;
     Vec2f           _origin;
     Vec3f           _color;
     Vec2f           _scale;
-    Vec3f           _positions[4]; // homogeneous vector
-    Vec2f           _texCoords[4];
 };
\ No newline at end of file
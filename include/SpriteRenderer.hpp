@@ -11,18 +11,36 @@
 #pragma once
 
 #include "SpriteSheet.hpp"
-#include "Entity.hpp"
+#include "Sprite.hpp"
 
 #include <gut_utils/TypeUtils.hpp>
 #include <gut_opengl/Shader.hpp>
 
+#include <cstdint>
+
 
 class Orientation;
-class Sprite;
+class RenderSnapshot;
 
 
 class SpriteRenderer {
 public:
+    // Per-sprite record uploaded as an instanced vertex attribute stream, the quad corners and
+    // texture coordinates are generated in the vertex shader
+    struct SpriteInstance {
+        Vec2f       position;   // world coordinates
+        float       rotation;
+        uint32_t    spriteId;
+        Vec2f       scale;      // orientation scale times sprite scale
+        Vec2f       origin;     // pixels
+        uint8_t     color[4];   // RGBA
+    };
+
+    enum class StreamingMode {
+        BufferData,         // reallocate and upload the instance buffer of every sprite sheet each frame
+        PersistentMapped    // write instances directly to a persistently mapped ring buffer
+    };
+
     SpriteRenderer();
 
     SpriteRenderer(const SpriteRenderer&) = delete;
@@ -41,28 +59,97 @@ public:
     const SpriteSheet& getSpriteSheet(SpriteSheetId id) const;
 
     void setWindowSize(int windowWidth, int windowHeight);
+    // Discards the sprites added since the last render
+    void setStreamingMode(StreamingMode streamingMode);
+    StreamingMode getStreamingMode() const;
+    // Snapshots with sprites smaller than lodThreshold pixels on screen are rendered as a heatmap
+    // of the snapshot grid cells instead, 0 disables
+    void setLodThreshold(float lodThreshold);
+    float getLodThreshold() const;
+    // Whether the last added snapshot was aggregated
+    bool isLodActive() const;
 
     void render(const Mat3f& viewport = Mat3f::Identity());
 
-    void operator()(EntityId id, Sprite& sprite, Orientation& orientation);
+    // Add the sprites of a snapshot with orientations interpolated from the previous (alpha = 0)
+    // to the current ones (alpha = 1). Sprites not overlapping the world space rectangle
+    // [visibleMin, visibleMax] are culled. With PersistentMapped streaming they are written
+    // straight to the mapped buffer. Zoomed out below the LOD threshold, the visible grid cells
+    // are aggregated into a heatmap instead.
+    void addSnapshot(const RenderSnapshot& snapshot, float alpha,
+        const Vec2f& visibleMin, const Vec2f& visibleMax);
 
     // Clear sprite memory without rendering;
     void clear();
 
 private:
-    std::vector<SpriteSheet>    _spriteSheets;
-    gut::Shader                 _shader;
-
-    int                         _windowWidth;
-    int                         _windowHeight;
-
-    GLuint                      _vertexArrayObjectId;
-    GLuint                      _positionBufferId;
-    GLuint                      _texCoordBufferId;
-    GLuint                      _colorBufferId;
-
-    Vector<Vector<Vec2f>>       _spriteVertexPositions;
-    Vector<Vector<Vec2f>>       _spriteVertexTexCoords;
-    Vector<Vector<Vec3f>>       _spriteVertexColors;
+    static constexpr int nStreamRegions = 3; // frames in flight
+
+    // Instances of a sprite sheet in the current stream region
+    struct DrawRange {
+        SpriteSheetId   spriteSheetId;
+        std::size_t     first;
+        std::size_t     count;
+    };
+
+    std::vector<SpriteSheet>        _spriteSheets;
+    gut::Shader                     _shader;
+    gut::Shader                     _heatmapShader;
+
+    int                             _windowWidth;
+    int                             _windowHeight;
+    float                           _maxSpriteDiagonal; // pixels, over all sprite sheets
+    float                           _maxSpriteArea; // square pixels, over all sprite sheets
+
+    StreamingMode                   _streamingMode;
+
+    GLuint                          _vertexArrayObjectId;
+    GLuint                          _instanceBufferId;
+
+    Vector<Vector<SpriteInstance>>  _spriteInstances; // per sprite sheet, BufferData streaming only
+
+    // Ring buffer of nStreamRegions regions, the region of a frame is reused once its fence
+    // signals that the GPU is done with it
+    GLuint                          _streamBufferId;
+    SpriteInstance*                 _streamMapping;
+    std::size_t                     _streamRegionCapacity; // instances
+    int                             _streamRegion;
+    std::size_t                     _streamRegionSize; // instances written to the current region
+    GLsync                          _streamFences[nStreamRegions];
+    std::vector<DrawRange>          _drawRanges;
+
+    // Aggregated rendering, RGBA8 texels of the visible snapshot grid cells covering the world
+    // space rectangle [_heatmapMin, _heatmapMax]
+    float                           _lodThreshold; // pixels
+    bool                            _lodActive;
+    GLuint                          _heatmapVertexArrayObjectId;
+    GLuint                          _heatmapTextureId;
+    int                             _heatmapTextureWidth;
+    int                             _heatmapTextureHeight;
+    std::vector<uint8_t>            _heatmapTexels;
+    int                             _heatmapWidth;
+    int                             _heatmapHeight;
+    Vec2f                           _heatmapMin;
+    Vec2f                           _heatmapMax;
+
+    void renderBufferData();
+    void renderPersistentMapped();
+    void renderHeatmap(const Mat3f& viewport);
+    // Aggregate the grid cells of a snapshot within [visibleMin, visibleMax] into heatmap texels
+    void addHeatmap(const RenderSnapshot& snapshot, const Vec2f& visibleMin, const Vec2f& visibleMax);
+    // Set the uniforms of a sprite sheet and bind its texture
+    void useSpriteSheet(SpriteSheetId spriteSheetId);
+
+    // Make room for count more instances in the current stream region
+    void reserveStreamInstances(std::size_t count);
+    // Reserve count instances of a sprite sheet in the current stream region, the returned pointer
+    // is valid until the stream is resized
+    SpriteInstance* allocateStreamInstances(SpriteSheetId spriteSheetId, std::size_t count);
+    // Replace the stream buffer with a larger one, keeping the current region contents
+    void resizeStream(std::size_t regionCapacity);
+
+    static void addSpriteInstance(const Sprite& sprite, const Orientation& orientation,
+        Vector<SpriteInstance>& instances);
+    static SpriteInstance makeSpriteInstance(const Sprite& sprite, const Orientation& orientation);
 };
 
@@ -51,5 +51,3 @@ private:
     int             _nSpritesY;
 };
 
-
-using SpriteSheetId = std::vector<SpriteSheet>::size_type;
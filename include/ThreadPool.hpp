@@ -0,0 +1,65 @@
+//
+// Project: rpg_world_simulator
+// File: ThreadPool.hpp
+//
+// Copyright (c) 2024 Miika 'Lehdari' Lehtimäki
+// You may use, distribute and modify this code under the terms
+// of the licence specified in file LICENSE which is distributed
+// with this source code package.
+//
+
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+
+// Work-stealing thread pool for data-parallel loops. Every thread (including the one calling
+// parallelFor) owns a queue of chunks, and threads running out of work steal from the others.
+class ThreadPool {
+public:
+    // nThreads is the total number of threads including the calling thread, 0 for one per core
+    explicit ThreadPool(std::size_t nThreads = 0);
+
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool(ThreadPool&&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+    ThreadPool& operator=(ThreadPool&&) = delete;
+
+    ~ThreadPool();
+
+    std::size_t getNumThreads() const;
+
+    // Call task(chunkId) for all chunkId in [0, nChunks) and return once all of them are done.
+    // Calls from inside a task are run serially on the calling thread.
+    void parallelFor(std::size_t nChunks, const std::function<void(std::size_t)>& task);
+
+private:
+    struct Queue {
+        std::mutex              mutex;
+        std::deque<std::size_t> chunks;
+    };
+
+    std::vector<std::thread>                        _threads;
+    std::vector<std::unique_ptr<Queue>>             _queues; // _queues[0] belongs to the calling thread
+
+    std::mutex                                      _mutex;
+    std::condition_variable                         _condition;
+    uint64_t                                        _generation;
+    bool                                            _quit;
+
+    std::mutex                                      _parallelForMutex;
+    const std::function<void(std::size_t)>*         _task;
+    std::atomic<std::size_t>                        _nRemaining;
+
+    void workerLoop(std::size_t queueId);
+    // Run a chunk from own queue or steal one from the others, returns false if there is no work left
+    bool runChunk(std::size_t queueId);
+};
@@ -0,0 +1,108 @@
+//
+// Project: rpg_world_simulator
+// File: Tracer.hpp
+//
+// Copyright (c) 2024 Miika 'Lehdari' Lehtimäki
+// You may use, distribute and modify this code under the terms
+// of the licence specified in file LICENSE which is distributed
+// with this source code package.
+//
+
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+
+// Recorder of spans and counters written as Chrome trace event JSON, viewable in chrome://tracing
+// and Perfetto. Every thread records into its own fixed size buffer without locking, events
+// exceeding the buffer capacity are dropped. Recording is done with the TRACE_* macros, which
+// compile to nothing unless RPG_WORLD_SIMULATOR_TRACING is defined.
+// start must not be called while other threads are recording, events recorded concurrently
+// with stop and write may be left out of the written trace.
+class Tracer {
+public:
+    using Clock = std::chrono::steady_clock;
+
+    static constexpr std::size_t bufferCapacity = 1 << 18; // events per thread
+
+    static Tracer& instance();
+
+    // Clear the previously recorded events and start recording
+    void start();
+    void stop();
+    bool isRecording() const;
+
+    // Event names need to outlive the tracer, string literals are fine
+    void begin(const char* name);
+    void end(const char* name);
+    void counter(const char* name, int64_t value);
+
+    // Returns false if the file could not be written
+    bool write(const std::string& fileName) const;
+
+private:
+    struct Event {
+        const char* name;
+        char        phase;
+        int64_t     time;   // nanoseconds since start
+        int64_t     value;
+    };
+
+    struct Buffer {
+        std::unique_ptr<Event[]>    events;
+        std::atomic<std::size_t>    size;
+        uint32_t                    threadId;
+    };
+
+    std::atomic<bool>                       _recording  {false};
+    Clock::time_point                       _startTime;
+    std::vector<std::unique_ptr<Buffer>>    _buffers;
+    mutable std::mutex                      _buffersMutex;
+
+    void record(const char* name, char phase, int64_t value);
+    Buffer* threadBuffer();
+};
+
+
+class ScopedSpan {
+public:
+    ScopedSpan(const char* name) :
+        _name   (name)
+    {
+        Tracer::instance().begin(_name);
+    }
+
+    ScopedSpan(const ScopedSpan&) = delete;
+    ScopedSpan& operator=(const ScopedSpan&) = delete;
+
+    ~ScopedSpan()
+    {
+        Tracer::instance().end(_name);
+    }
+
+private:
+    const char* _name;
+};
+
+
+#define TRACE_CONCAT_INNER(A, B) A##B
+#define TRACE_CONCAT(A, B) TRACE_CONCAT_INNER(A, B)
+
+#ifdef RPG_WORLD_SIMULATOR_TRACING
+// Record the rest of the enclosing scope as a span
+#define TRACE_SCOPE(NAME) ScopedSpan TRACE_CONCAT(traceSpan, __LINE__)(NAME)
+#define TRACE_BEGIN(NAME) Tracer::instance().begin(NAME)
+#define TRACE_END(NAME) Tracer::instance().end(NAME)
+#define TRACE_COUNTER(NAME, VALUE) Tracer::instance().counter(NAME, (int64_t)(VALUE))
+#else
+#define TRACE_SCOPE(NAME)
+#define TRACE_BEGIN(NAME)
+#define TRACE_END(NAME)
+#define TRACE_COUNTER(NAME, VALUE)
+#endif
@@ -40,6 +40,12 @@ public:
 
     Vec2f toWorld(const Vec2f& position);
 
+    /** @brief  Get the world space bounding rectangle of the area visible in the window
+     *  @param  worldMin    Minimum corner of the rectangle, in world coordinates
+     *  @param  worldMax    Maximum corner of the rectangle, in world coordinates
+     */
+    void getVisibleRectangle(Vec2f& worldMin, Vec2f& worldMax) const;
+
     float getWindowWidth() const;
     float getWindowHeight() const;
     const Mat3f& getViewport() const;
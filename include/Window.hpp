@@ -13,8 +13,7 @@
 
 #include <Viewport.hpp>
 #include <SpriteRenderer.hpp>
-#include <CollisionHandler.hpp>
-#include <World.hpp>
+#include <Simulation.hpp>
 #include <string>
 #include <SDL.h>
 #include <glad/glad.h>
@@ -112,7 +111,6 @@ private:
     SDL_GLContext                   _glCtx;
 
     bool                            _quit; // flag for quitting the application
-    bool                            _paused; // flag for pausing the simulation
     Viewport                        _viewport;
     Vec2f                           _cursorPosition;
     int                             _renderMode;
@@ -120,13 +118,13 @@ private:
     uint32_t                        _lastTicks;
     uint32_t                        _frameTicks;
 
+    int                             _traceTicks; // number of ticks to capture in a trace
+
     Window::Context                 _windowContext;
 
-    // Component pool, systems and the world
-    ComponentPool<COMPONENT_TYPES>  _componentPool;
-    World                           _world;
+    // Simulation running on its own thread and the renderer consuming its snapshots
+    Simulation                      _simulation;
     SpriteRenderer                  _spriteRenderer;
-    CollisionHandler                _collisionHandler;
 
     // Resources
     SpriteSheetId                   _spriteSheetId;
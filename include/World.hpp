@@ -12,39 +12,159 @@
 
 #include "Components.hpp"
 #include "ComponentPool.hpp"
+#include "EntityContainer.hpp"
 #include "NPC.hpp"
 #include "Food.hpp"
-#include "EntityFinder.hpp"
+#include "SpatialGrid.hpp"
+#include "EntityCommandBuffer.hpp"
+#include "Random.hpp"
+#include "Profiler.hpp"
+#include "Tracer.hpp"
+#include "ThreadPool.hpp"
 
 #include <vector>
 
 
-class SpriteRenderer;
 class CollisionHandler;
 
 
 class World {
 public:
-    World(ComponentPool<COMPONENT_TYPES>* componentPool);
+    // Serial updates the entities one at a time. Parallel splits the update loops over the thread
+    // pool, results are identical as entities read each other only through the spatial grid.
+    enum class UpdateMode {
+        Serial,
+        Parallel
+    };
 
+    // size is the radius of the world around origin, runs with the same seed are reproducible
+    World(ComponentPool<COMPONENT_TYPES>* componentPool, double size = 15.0, uint64_t seed = 0);
+
+    // Entity updates read the other entities through the spatial grid, which holds their state
+    // before the update loops, and write only their own components
     void update(CollisionHandler* handler);
-    void render(SpriteRenderer* renderer);
+    void setUpdateMode(UpdateMode updateMode);
+    UpdateMode getUpdateMode() const;
 
+    // Entity creation and removal are queued and applied at the sync points of update. args are the
+    // constructor arguments preceding the seed and tick, which the world supplies when the
+    // creation is applied so that the initial state is drawn from the stream of the new entity.
+    template <typename T_Entity, typename... T_Args>
+    void createEntity(T_Args&&... args);
+    // Stale ids of already destroyed entities are ignored
+    void removeEntity(EntityId id);
     void removeNPC(NPC* npc);
     void removeFood(Food* food);
+    bool isRemoved(EntityId id) const;
+
     void spawnFood();
 
     void getEntitiesWithinRadius(const Vec2f& point, double radius,
         std::vector<std::pair<EntityId, TypeId>>* entityHandles);
+    // Find the entity of type T_Entity nearest to point within maxRadius, nullptr if there is none.
+    // Its position at the time the spatial grid was built is written to gridPosition if provided.
+    template <typename T_Entity>
+    T_Entity* findNearest(const Vec2f& point, double maxRadius, Vec2f* gridPosition = nullptr);
     double getSize() const;
+    uint64_t getSeed() const;
+    // Number of completed updates
+    uint64_t getTick() const;
+    // Random number stream of an entity for the current tick
+    Random getRandom(EntityId id, uint32_t stream) const;
+    std::size_t getMaxFood() const;
+    template <typename T_Entity>
+    std::size_t getNumEntities() const;
+    ThreadPool* getThreadPool();
 
     ComponentPool<COMPONENT_TYPES>* componentPool;
 
 private:
     double                          _size;  // radius around origin
+    uint64_t                        _seed;
+    uint64_t                        _tick;
+    UpdateMode                      _updateMode;
+
+    EntityContainers<ENTITY_TYPES>  _entities;
+
+    SpatialGrid                     _spatialGrid;
+    ThreadPool                      _threadPool;
+    EntityCommandBuffer             _commandBuffer;
 
-    std::vector<NPC>                _npcs;
-    std::vector<Food>               _food;
+    // Rebuild the spatial grid from current entity positions
+    void updateSpatialGrid();
+    // Sync point: apply the queued entity removals and creations
+    void applyCommands();
 
-    EntityFinder                    _entityFinder;
+    template <typename T_Entity>
+    EntityContainer<T_Entity>& getEntities();
+    // Entities are updated in chunks of this many, also when updating serially
+    static constexpr std::size_t updateChunkSize = 256;
+
+    template <typename T_Entity>
+    void updateEntities(EntityContainer<T_Entity>& entities);
+    // Update the entities [begin, end), at most updateChunkSize of them
+    template <typename T_Entity>
+    void updateChunk(EntityContainer<T_Entity>& entities, std::size_t begin, std::size_t end);
+    // Food growth of the whole chunk is drawn with a single Random::uniformBatch call
+    void updateChunk(EntityContainer<Food>& food, std::size_t begin, std::size_t end);
 };
+
+
+template <typename T_Entity, typename... T_Args>
+void World::createEntity(T_Args&&... args)
+{
+    _commandBuffer.create([this, ...args = std::forward<T_Args>(args)]() mutable {
+        getEntities<T_Entity>().emplace_back(componentPool->createEntity<T_Entity>(std::move(args)..., _seed, _tick));
+    });
+}
+
+template <typename T_Entity>
+T_Entity* World::findNearest(const Vec2f& point, double maxRadius, Vec2f* gridPosition)
+{
+    const auto* entry = _spatialGrid.findNearest(point, (float)maxRadius, [&](const SpatialGrid::Entry& entry) {
+        // Skip entities removed after the grid was built
+        return entry.entityTypeId == entityTypeId<T_Entity>() &&
+            componentPool->getEntityHandle(entry.id) != nullptr && !_commandBuffer.isRemoved(entry.id);
+    });
+    if (entry == nullptr)
+        return nullptr;
+
+    if (gridPosition != nullptr)
+        *gridPosition = entry->position;
+    return static_cast<T_Entity*>(componentPool->getEntityHandle(entry->id));
+}
+
+template <typename T_Entity>
+std::size_t World::getNumEntities() const
+{
+    return std::get<EntityContainer<T_Entity>>(_entities).size();
+}
+
+template <typename T_Entity>
+EntityContainer<T_Entity>& World::getEntities()
+{
+    return std::get<EntityContainer<T_Entity>>(_entities);
+}
+
+template <typename T_Entity>
+void World::updateEntities(EntityContainer<T_Entity>& entities)
+{
+    PROFILE_SCOPE(std::string(entityTypeName<T_Entity>()) + " update");
+    TRACE_SCOPE(entityTypeName<T_Entity>());
+    if (_updateMode == UpdateMode::Serial) {
+        for (std::size_t begin=0; begin<entities.size(); begin+=updateChunkSize)
+            updateChunk(entities, begin, std::min(entities.size(), begin+updateChunkSize));
+        return;
+    }
+
+    _threadPool.parallelFor((entities.size() + updateChunkSize - 1) / updateChunkSize, [&](std::size_t chunkId) {
+        updateChunk(entities, chunkId*updateChunkSize, std::min(entities.size(), (chunkId+1)*updateChunkSize));
+    });
+}
+
+template <typename T_Entity>
+void World::updateChunk(EntityContainer<T_Entity>& entities, std::size_t begin, std::size_t end)
+{
+    for (std::size_t i=begin; i<end; ++i)
+        entities[i].update(this);
+}
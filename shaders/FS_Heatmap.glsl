@@ -0,0 +1,23 @@
+//
+// Project: rpg_world_simulator
+// File: FS_Heatmap.glsl
+//
+// Copyright (c) 2024 Miika 'Lehdari' Lehtimäki
+// You may use, distribute and modify this code under the terms
+// of the licence specified in file LICENSE which is distributed
+// with this source code package.
+//
+
+#version 420
+
+
+in vec2 vTexCoord;
+
+out vec4 fragColor;
+
+uniform sampler2D   tex;
+
+
+void main() {
+    fragColor = texture(tex, vTexCoord);
+}
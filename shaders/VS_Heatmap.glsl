@@ -0,0 +1,33 @@
+//
+// Project: rpg_world_simulator
+// File: VS_Heatmap.glsl
+//
+// Copyright (c) 2024 Miika 'Lehdari' Lehtimäki
+// You may use, distribute and modify this code under the terms
+// of the licence specified in file LICENSE which is distributed
+// with this source code package.
+//
+
+#version 420
+
+
+out vec2 vTexCoord;
+
+uniform int windowWidth;
+uniform int windowHeight;
+
+// Unit square to window coordinates
+uniform mat3 transform;
+
+
+void main() {
+    // Quad corner from the vertex index of a 4 vertex triangle strip
+    vec2 corner = vec2(gl_VertexID & 1, gl_VertexID >> 1);
+    vec3 p = transform * vec3(corner, 1.0);
+    vTexCoord = corner;
+
+    gl_Position = vec4(
+        2.0*p.x/windowWidth - 1.0,
+        1.0 - 2.0*p.y/windowHeight,
+        0.0, 1.0);
+}
@@ -11,9 +11,13 @@
 #version 420
 
 
+// Per-instance attributes, see SpriteRenderer::SpriteInstance
 layout(location = 0) in vec2 position;
-layout(location = 1) in vec2 texCoord;
-layout(location = 2) in vec3 color;
+layout(location = 1) in float rotation;
+layout(location = 2) in uint spriteId;
+layout(location = 3) in vec2 scale;
+layout(location = 4) in vec2 origin;
+layout(location = 5) in vec4 color;
 
 out vec2 vPosition;
 out vec2 vTexCoord;
@@ -24,14 +28,33 @@ uniform int windowHeight;
 
 uniform mat3 viewport;
 
+// Sprite sheet layout
+uniform int spriteWidth;
+uniform int spriteHeight;
+uniform int nSpritesX;
+uniform int textureWidth;
+uniform int textureHeight;
+
 
 void main() {
-    vec3 p = viewport * vec3(position, 1.0);
+    // Quad corner from the vertex index of a 4 vertex triangle strip
+    vec2 corner = vec2(gl_VertexID & 1, gl_VertexID >> 1);
+    vec2 spriteSize = vec2(spriteWidth, spriteHeight);
+
+    vec2 local = scale * (corner*spriteSize - origin);
+    float c = cos(rotation);
+    float s = sin(rotation);
+    vec2 world = position + vec2(c*local.x - s*local.y, s*local.x + c*local.y);
+
+    vec3 p = viewport * vec3(world, 1.0);
     vPosition = vec2(
         2.0*p.x/windowWidth - 1.0,
         1.0 - 2.0*p.y/windowHeight);
-    vTexCoord = texCoord;
-    vColor = color;
+
+    int id = int(spriteId);
+    vec2 cell = vec2(id % nSpritesX, id / nSpritesX);
+    vTexCoord = (cell + corner) * spriteSize / vec2(textureWidth, textureHeight);
+    vColor = color.rgb;
 
     gl_Position = vec4(vPosition, 0.0, 1.0);
 }
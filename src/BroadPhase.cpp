@@ -0,0 +1,164 @@
+//
+// Project: rpg_world_simulator
+// File: BroadPhase.cpp
+//
+// Copyright (c) 2024 Miika 'Lehdari' Lehtimäki
+// You may use, distribute and modify this code under the terms
+// of the licence specified in file LICENSE which is distributed
+// with this source code package.
+//
+
+#include "BroadPhase.hpp"
+#include "Label.hpp"
+#include "CollisionBody.hpp"
+#include "Orientation.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+
+static constexpr float minCellSize = 1.0e-3f;
+static constexpr double maxCellsPerBody = 4.0;
+// Cell coordinates are clamped to this, no grid spanning at most maxCellsPerBody cells per body reaches it
+static constexpr float maxCellCoordinate = (float)(1 << 29);
+
+
+// Clamped so that rounding at the grid bounds and overflowing coordinates stay representable
+static inline int32_t clampCellCoordinate(float c)
+{
+    c = std::floor(c);
+    if (!(c > 0.0f)) // also catches NaN
+        return 0;
+    return (int32_t)std::min(c, maxCellCoordinate);
+}
+
+
+BroadPhase::BroadPhase() :
+    _cellSize       (1.0f),
+    _cellSizeInv    (1.0f),
+    _min            (0.0f, 0.0f),
+    _width          (0),
+    _height         (0)
+{
+}
+
+void BroadPhase::clear()
+{
+    _bodies.clear();
+    _pairs.clear();
+}
+
+void BroadPhase::operator()(EntityId id, Label& label, CollisionBody& collisionBody, Orientation& orientation)
+{
+    // Bodies with non-finite bounds cannot be placed in the grid
+    if (orientation.getPosition().allFinite() && std::isfinite(collisionBody.getRadius()))
+        _bodies.push_back({id, label.entityTypeId, orientation.getPosition(), collisionBody.getRadius()});
+}
+
+void BroadPhase::build()
+{
+    _pairs.clear();
+    if (_bodies.size() < 2)
+        return;
+
+    // Bounds of all bounding boxes and the mean radius
+    constexpr float inf = std::numeric_limits<float>::infinity();
+    Vec2f max(-inf, -inf);
+    _min << inf, inf;
+    double radiusSum = 0.0;
+    for (const auto& body : _bodies) {
+        _min(0) = std::min(_min(0), body.position(0)-body.radius);
+        _min(1) = std::min(_min(1), body.position(1)-body.radius);
+        max(0) = std::max(max(0), body.position(0)+body.radius);
+        max(1) = std::max(max(1), body.position(1)+body.radius);
+        radiusSum += body.radius;
+    }
+
+    // Cells fit an average body, coarsen if the bodies are so sparse that the number of cells
+    // would not be linear in the number of bodies. The extent is computed in double precision as
+    // it may exceed the float range for far apart bodies.
+    _cellSize = std::max(2.0f*(float)(radiusSum/(double)_bodies.size()), minCellSize);
+    double extentX = (double)max(0) - (double)_min(0);
+    double extentY = (double)max(1) - (double)_min(1);
+    while ((extentX/_cellSize + 1.0)*(extentY/_cellSize + 1.0) > maxCellsPerBody*(double)_bodies.size())
+        _cellSize *= 2.0f;
+    _cellSizeInv = 1.0f / _cellSize;
+    _width = cellX(max(0)) + 1;
+    _height = cellY(max(1)) + 1;
+
+    // Counting sort of the bodies into all cells their bounding boxes overlap
+    _cellStarts.assign((std::size_t)_width*_height + 1, 0);
+    for (const auto& body : _bodies) {
+        int32_t x1 = cellX(body.position(0)-body.radius);
+        int32_t x2 = cellX(body.position(0)+body.radius);
+        int32_t y1 = cellY(body.position(1)-body.radius);
+        int32_t y2 = cellY(body.position(1)+body.radius);
+        for (int32_t y=y1; y<=y2; ++y) {
+            for (int32_t x=x1; x<=x2; ++x)
+                ++_cellStarts[y*_width + x + 1];
+        }
+    }
+    for (std::size_t i=1; i<_cellStarts.size(); ++i)
+        _cellStarts[i] += _cellStarts[i-1];
+
+    _cellBodies.resize(_cellStarts.back());
+    _cellFill.assign(_cellStarts.begin(), _cellStarts.end()-1);
+    for (uint32_t i=0; i<_bodies.size(); ++i) {
+        const auto& body = _bodies[i];
+        int32_t x1 = cellX(body.position(0)-body.radius);
+        int32_t x2 = cellX(body.position(0)+body.radius);
+        int32_t y1 = cellY(body.position(1)-body.radius);
+        int32_t y2 = cellY(body.position(1)+body.radius);
+        for (int32_t y=y1; y<=y2; ++y) {
+            for (int32_t x=x1; x<=x2; ++x)
+                _cellBodies[_cellFill[y*_width + x]++] = i;
+        }
+    }
+
+    // Test the bodies sharing a cell. A pair overlapping several cells is reported only in the
+    // cell containing the minimum corner of the intersection of the bounding boxes.
+    for (int32_t y=0; y<_height; ++y) {
+        for (int32_t x=0; x<_width; ++x) {
+            uint32_t begin = _cellStarts[y*_width + x];
+            uint32_t end = _cellStarts[y*_width + x + 1];
+            for (uint32_t i=begin; i+1<end; ++i) {
+                const auto& body1 = _bodies[_cellBodies[i]];
+                for (uint32_t j=i+1; j<end; ++j) {
+                    const auto& body2 = _bodies[_cellBodies[j]];
+                    float totalRadius = body1.radius + body2.radius;
+                    if (std::abs(body1.position(0)-body2.position(0)) >= totalRadius ||
+                        std::abs(body1.position(1)-body2.position(1)) >= totalRadius)
+                        continue;
+
+                    float cornerX = std::max(body1.position(0)-body1.radius, body2.position(0)-body2.radius);
+                    float cornerY = std::max(body1.position(1)-body1.radius, body2.position(1)-body2.radius);
+                    if (cellX(cornerX) != x || cellY(cornerY) != y)
+                        continue;
+
+                    _pairs.emplace_back(std::min(body1.id, body2.id), std::max(body1.id, body2.id));
+                }
+            }
+        }
+    }
+
+    // Deterministic order independent of the cell layout
+    std::sort(_pairs.begin(), _pairs.end(), [](const auto& p1, const auto& p2) {
+        return p1.second < p2.second || (p1.second == p2.second && p1.first < p2.first);
+    });
+}
+
+const std::vector<std::pair<EntityId, EntityId>>& BroadPhase::getPairs() const
+{
+    return _pairs;
+}
+
+int32_t BroadPhase::cellX(float x) const
+{
+    return clampCellCoordinate((x-_min(0)) * _cellSizeInv);
+}
+
+int32_t BroadPhase::cellY(float y) const
+{
+    return clampCellCoordinate((y-_min(1)) * _cellSizeInv);
+}
@@ -13,75 +13,275 @@
 #include "World.hpp"
 #include "NPC.hpp"
 #include "Food.hpp"
+#include "Profiler.hpp"
+#include "Tracer.hpp"
 
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <tuple>
+#include <utility>
 
-CollisionHandler::CollisionCallBackArray CollisionHandler::_collisionCallbacks =
-    []()
+
+// Entity type with a type id
+template <TypeId T_TypeId>
+using EntityOfTypeId = std::tuple_element_t<T_TypeId, std::tuple<ENTITY_TYPES>>;
+
+// Whether handleCollision is implemented for the types, mirrored type pairs are omitted so that
+// mirrored handleCollision function definitions are not needed (for example
+// handleCollision(NPC*, Food*) and handleCollision(Food*, NPC*))
+template <uint32_t T_TypePair>
+static constexpr bool isHandled = T_TypePair / N_ENTITY_TYPES <= T_TypePair % N_ENTITY_TYPES &&
+    requires(World* w, Interactions* i, EntityOfTypeId<T_TypePair / N_ENTITY_TYPES>* a,
+        EntityOfTypeId<T_TypePair % N_ENTITY_TYPES>* b) {
+        CollisionHandler::handleCollision(w, i, a, b);
+    };
+
+// Entities written for a type pair, both for the pairs without a handler
+template <uint32_t T_TypePair>
+static constexpr CollisionHandler::Writes getWrites()
 {
-    CollisionCallBackArray callbacks{};
-    CallbacksInitializer<ENTITY_TYPES>::callbacksInitializerOuter<ENTITY_TYPES>(callbacks.data());
-    return callbacks;
-}();
+    if constexpr (isHandled<T_TypePair>) {
+        return CollisionHandler::writes((EntityOfTypeId<T_TypePair / N_ENTITY_TYPES>*)nullptr,
+            (EntityOfTypeId<T_TypePair % N_ENTITY_TYPES>*)nullptr);
+    }
+    else
+        return CollisionHandler::Writes::Both;
+}
+
+static constexpr auto typePairWrites = []<std::size_t... T_TypePairs>(std::index_sequence<T_TypePairs...>) {
+        return std::array<CollisionHandler::Writes, CollisionHandler::nTypePairs>{getWrites<T_TypePairs>()...};
+    }(std::make_index_sequence<CollisionHandler::nTypePairs>());
+
+static_assert([]<std::size_t... T_TypePairs>(std::index_sequence<T_TypePairs...>) {
+        return ((isHandled<T_TypePairs> || T_TypePairs / N_ENTITY_TYPES > T_TypePairs % N_ENTITY_TYPES) && ...);
+    }(std::make_index_sequence<CollisionHandler::nTypePairs>()),
+    "handleCollision is not implemented for all entity type pairs (see CollisionHandlers.inl)");
 
 
 CollisionHandler::CollisionHandler(ComponentPool<COMPONENT_TYPES>* componentPool, World* world) :
-    _componentPool  (componentPool)
+    _componentPool  (componentPool),
+    _world          (world)
 {
-    _subHandler.componentPool = componentPool;
-    _subHandler.world = world;
 }
 
-void CollisionHandler::operator()(EntityId id, Label& label, CollisionBody& collisionBody, Orientation& orientation)
+void CollisionHandler::run()
+{
+    TRACE_SCOPE("Collision");
+    {
+        PROFILE_SCOPE("Collision broad phase");
+        TRACE_SCOPE("Collision broad phase");
+        _broadPhase.clear();
+        _componentPool->runSystem<BroadPhase, Label, CollisionBody, Orientation>(&_broadPhase);
+        _broadPhase.build();
+    }
+
+    {
+        PROFILE_SCOPE("Collision contacts");
+        TRACE_SCOPE("Collision contacts");
+        TRACE_COUNTER("Collision pairs tested", _broadPhase.getPairs().size());
+        std::size_t nPairs = _broadPhase.getPairs().size();
+        std::size_t nChunks = (nPairs + pairChunkSize - 1) / pairChunkSize;
+        if (_chunkContacts.size() < nChunks)
+            _chunkContacts.resize(nChunks);
+        runChunks(nChunks, [&](std::size_t chunkId) {
+            generateContacts(chunkId*pairChunkSize, std::min(nPairs, (chunkId+1)*pairChunkSize),
+                &_chunkContacts[chunkId]);
+        });
+        sortContacts(nChunks);
+    }
+
+    std::size_t nChunks = 0;
+    {
+        PROFILE_SCOPE("Collision resolution");
+        TRACE_SCOPE("Collision resolution");
+        TRACE_COUNTER("Contacts", _contacts.size());
+        _entityBatches.assign(_componentPool->getNumEntitySlots(), 0);
+        for (uint32_t typePair=0; typePair<nTypePairs; ++typePair) {
+            if (_typePairStarts[typePair] == _typePairStarts[typePair+1])
+                continue;
+
+            buildBatches(typePair, _typePairStarts[typePair], _typePairStarts[typePair+1]);
+            for (uint32_t batch=0; batch<=maxBatches; ++batch) {
+                std::size_t begin = _batchStarts[batch];
+                std::size_t end = _batchStarts[batch+1];
+                if (begin == end)
+                    continue;
+
+                // Contacts of the overflow batch may share entities, it is resolved as a single chunk
+                std::size_t chunkSize = batch == maxBatches ? end-begin : pairChunkSize;
+                std::size_t nBatchChunks = (end - begin + chunkSize - 1) / chunkSize;
+                if (_interactions.size() < nChunks+nBatchChunks)
+                    _interactions.resize(nChunks+nBatchChunks);
+
+                runChunks(nBatchChunks, [&, firstChunk = nChunks](std::size_t chunkId) {
+                    auto& interactions = _interactions[firstChunk + chunkId];
+                    interactions.clear();
+                    resolveContacts(typePair, begin + chunkId*chunkSize,
+                        std::min(end, begin + (chunkId+1)*chunkSize), &interactions);
+                });
+                nChunks += nBatchChunks;
+            }
+        }
+    }
+
+    PROFILE_SCOPE("Collision interactions");
+    TRACE_SCOPE("Collision interactions");
+    commitInteractions(nChunks);
+}
+
+void CollisionHandler::runChunks(std::size_t nChunks, const std::function<void(std::size_t)>& task)
 {
-    _subHandler.outerId = id;
-    _subHandler.outerLabel = &label;
-    _subHandler.outerCollisionBody = &collisionBody;
-    _subHandler.outerOrientation = &orientation;
-    _componentPool->runSystem<CollisionSubHandler, Label, CollisionBody, Orientation>(&_subHandler);
+    if (_world->getUpdateMode() == World::UpdateMode::Serial || nChunks <= 1) {
+        for (std::size_t chunkId=0; chunkId<nChunks; ++chunkId)
+            task(chunkId);
+        return;
+    }
+
+    _world->getThreadPool()->parallelFor(nChunks, task);
 }
 
-template<typename T_Entity1, typename T_Entity2>
-void CollisionHandler::handleCollision(World* world, void* entity1, void* entity2)
+float CollisionHandler::getPenetration(EntityId id1, EntityId id2)
 {
-    handleCollision(world, static_cast<T_Entity1*>(entity1), static_cast<T_Entity2*>(entity2));
+    float dist = (_componentPool->getComponent<Orientation>(id2).getPosition() -
+        _componentPool->getComponent<Orientation>(id1).getPosition()).norm();
+    return _componentPool->getComponent<CollisionBody>(id1)._radius +
+        _componentPool->getComponent<CollisionBody>(id2)._radius - dist;
 }
 
-void CollisionHandler::CollisionSubHandler::operator()(
-    EntityId id,
-    Label& label,
-    CollisionBody& collisionBody,
-    Orientation& orientation
-) {
-    if (id >= outerId)
-        return;
+void CollisionHandler::generateContacts(std::size_t begin, std::size_t end, std::vector<Contact>* contacts)
+{
+    contacts->clear();
+    const auto& pairs = _broadPhase.getPairs();
+    for (std::size_t i=begin; i<end; ++i) {
+        auto [id1, id2] = pairs[i];
+        // Entities might have been removed during the update
+        if (_world->isRemoved(id1) || _world->isRemoved(id2) ||
+            _componentPool->getEntityHandle(id1) == nullptr || _componentPool->getEntityHandle(id2) == nullptr)
+            continue;
+
+        TypeId typeId1 = _componentPool->getComponent<Label>(id1).entityTypeId;
+        TypeId typeId2 = _componentPool->getComponent<Label>(id2).entityTypeId;
+        if (typeId2 < typeId1) {
+            std::swap(id1, id2);
+            std::swap(typeId1, typeId2);
+        }
+        if (getPenetration(id1, id2) > 0.0f)
+            contacts->push_back({id1, id2, (uint32_t)(typeId1*N_ENTITY_TYPES + typeId2)});
+    }
+}
 
-    auto* outerEntity = componentPool->getEntityHandle(outerId);
-    if (outerEntity == nullptr) return;
-    auto* entity = componentPool->getEntityHandle(id);
-    if (entity == nullptr) return;
-
-    float dist = (outerOrientation->getPosition() - orientation.getPosition()).squaredNorm();
-    float totalRadius = outerCollisionBody->_radius + collisionBody._radius;
-    if (dist < totalRadius * totalRadius) {
-        // Pick the collision function so that mirrored handleCollision function definitions are not needed
-        // (for example handleCollision(NPC*, Food*) and handleCollision(Food*, NPC*))
-        uint64_t functionId;
-        if (outerLabel->entityTypeId < label.entityTypeId) {
-            functionId = label.entityTypeId + outerLabel->entityTypeId*N_ENTITY_TYPES;
-            // If you're getting segfault here it's likely that you forgot to overload handleCollision for
-            // the entity types that collided
-            CollisionHandler::_collisionCallbacks[functionId](world,
-                componentPool->getEntityHandle(outerId), componentPool->getEntityHandle(id));
+void CollisionHandler::sortContacts(std::size_t nChunks)
+{
+    // Counting sort by type pair, keeping the broad phase order within the type pairs
+    _typePairStarts.fill(0);
+    for (std::size_t chunkId=0; chunkId<nChunks; ++chunkId) {
+        for (const auto& contact : _chunkContacts[chunkId])
+            ++_typePairStarts[contact.typePair+1];
+    }
+    for (uint32_t i=1; i<_typePairStarts.size(); ++i)
+        _typePairStarts[i] += _typePairStarts[i-1];
+
+    _contacts.resize(_typePairStarts.back());
+    std::array<uint32_t, nTypePairs> typePairFill;
+    std::copy(_typePairStarts.begin(), _typePairStarts.end()-1, typePairFill.begin());
+    for (std::size_t chunkId=0; chunkId<nChunks; ++chunkId) {
+        for (const auto& contact : _chunkContacts[chunkId])
+            _contacts[typePairFill[contact.typePair]++] = contact;
+    }
+}
+
+void CollisionHandler::buildBatches(uint32_t typePair, std::size_t begin, std::size_t end)
+{
+    // Each contact goes to the first batch none of its written entities is in yet
+    bool writesA = typePairWrites[typePair] != Writes::B;
+    bool writesB = typePairWrites[typePair] != Writes::A;
+    _contactBatches.resize(end-begin);
+    _batchStarts.assign(maxBatches+2, begin);
+    for (std::size_t i=begin; i<end; ++i) {
+        uint64_t& batches1 = _entityBatches[entityIndex(_contacts[i].idA)];
+        uint64_t& batches2 = _entityBatches[entityIndex(_contacts[i].idB)];
+        uint64_t usedBatches = (writesA ? batches1 : 0) | (writesB ? batches2 : 0);
+        uint32_t batch = (uint32_t)std::countr_one(usedBatches); // maxBatches if all are used
+        if (batch < maxBatches) {
+            if (writesA)
+                batches1 |= 1ull << batch;
+            if (writesB)
+                batches2 |= 1ull << batch;
         }
-        else {
-            functionId = outerLabel->entityTypeId + label.entityTypeId*N_ENTITY_TYPES;
-            // If you're getting segfault here it's likely that you forgot to overload handleCollision for
-            // the entity types that collided
-            CollisionHandler::_collisionCallbacks[functionId](world,
-                componentPool->getEntityHandle(id), componentPool->getEntityHandle(outerId));
+        _contactBatches[i-begin] = batch;
+        ++_batchStarts[batch+1];
+    }
+    TRACE_COUNTER("Collision batches", std::count_if(_batchStarts.begin()+1, _batchStarts.end(),
+        [begin](uint32_t size) { return size > begin; }));
+
+    // Counting sort by batch, keeping the order within the batches
+    for (std::size_t i=1; i<_batchStarts.size(); ++i)
+        _batchStarts[i] += _batchStarts[i-1] - begin;
+    _batchedContacts.resize(end-begin);
+    for (std::size_t i=begin; i<end; ++i)
+        _batchedContacts[_batchStarts[_contactBatches[i-begin]]++ - begin] = _contacts[i];
+    // Filling advanced the starts by one batch
+    std::copy_backward(_batchStarts.begin(), _batchStarts.end()-1, _batchStarts.end());
+    _batchStarts[0] = begin;
+    std::copy(_batchedContacts.begin(), _batchedContacts.end(), _contacts.begin()+begin);
+
+    // Clear the batches of the entities for the next type pair
+    for (std::size_t i=begin; i<end; ++i) {
+        _entityBatches[entityIndex(_contacts[i].idA)] = 0;
+        _entityBatches[entityIndex(_contacts[i].idB)] = 0;
+    }
+}
+
+void CollisionHandler::resolveContacts(uint32_t typePair, std::size_t begin, std::size_t end,
+    Interactions* interactions)
+{
+    // Dispatch to the specialized loop once per chunk
+    [&]<std::size_t... T_TypePairs>(std::index_sequence<T_TypePairs...>) {
+        ((typePair == T_TypePairs && (resolveContacts<T_TypePairs>(begin, end, interactions), true)) || ...);
+    }(std::make_index_sequence<nTypePairs>());
+}
+
+template <uint32_t T_TypePair>
+void CollisionHandler::resolveContacts(std::size_t begin, std::size_t end, Interactions* interactions)
+{
+    if constexpr (isHandled<T_TypePair>) {
+        using T_Entity1 = EntityOfTypeId<T_TypePair / N_ENTITY_TYPES>;
+        using T_Entity2 = EntityOfTypeId<T_TypePair % N_ENTITY_TYPES>;
+        for (std::size_t i=begin; i<end; ++i) {
+            const auto& contact = _contacts[i];
+            // Contacts resolved in earlier batches might have separated the bodies
+            if (getPenetration(contact.idA, contact.idB) <= 0.0f)
+                continue;
+
+            handleCollision(_world, interactions,
+                static_cast<T_Entity1*>(_componentPool->getEntityHandle(contact.idA)),
+                static_cast<T_Entity2*>(_componentPool->getEntityHandle(contact.idB)));
         }
     }
 }
 
+void CollisionHandler::commitInteractions(std::size_t nChunks)
+{
+    _eats.clear();
+    for (std::size_t chunkId=0; chunkId<nChunks; ++chunkId)
+        _eats.insert(_eats.end(), _interactions[chunkId].eats.begin(), _interactions[chunkId].eats.end());
+    TRACE_COUNTER("Eat intents", _eats.size());
+
+    // NPCs reaching the same food eat it in ascending id order
+    std::sort(_eats.begin(), _eats.end(), [](const auto& eat1, const auto& eat2) {
+        return eat1.foodId < eat2.foodId || (eat1.foodId == eat2.foodId && eat1.npcId < eat2.npcId);
+    });
+    for (const auto& eat : _eats) {
+        // Food might have been eaten entirely by an earlier NPC
+        if (_world->isRemoved(eat.foodId) || _world->isRemoved(eat.npcId))
+            continue;
+        auto* npc = static_cast<NPC*>(_componentPool->getEntityHandle(eat.npcId));
+        auto* food = static_cast<Food*>(_componentPool->getEntityHandle(eat.foodId));
+        if (npc != nullptr && food != nullptr)
+            commitEat(_world, npc, food);
+    }
+}
+
 // Looks weird but helps to keep the code a bit more clean as this file contains much of the abstract machinery
 #include "CollisionHandlers.cpp"
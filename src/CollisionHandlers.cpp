@@ -8,7 +8,7 @@
 // with this source code package.
 //
 
-void CollisionHandler::handleCollision(World* world, NPC* npc1, NPC* npc2)
+void CollisionHandler::handleCollision(World* world, Interactions* interactions, NPC* npc1, NPC* npc2)
 {
     {   // Physics collision
         Vec2f fromOther = npc1->component<Orientation>().getPosition() - npc2->component<Orientation>().getPosition();
@@ -42,7 +42,7 @@ void CollisionHandler::handleCollision(World* world, NPC* npc1, NPC* npc2)
     }
 }
 
-void CollisionHandler::handleCollision(World* world, NPC* npc, Food* food)
+void CollisionHandler::handleCollision(World* world, Interactions* interactions, NPC* npc, Food* food)
 {
     {   // Physics collision
         Vec2f fromOther = npc->component<Orientation>().getPosition() - food->component<Orientation>().getPosition();
@@ -55,6 +55,12 @@ void CollisionHandler::handleCollision(World* world, NPC* npc, Food* food)
         npc->component<Orientation>().translate(fromOtherUnit * overlap);
     }
 
+    // Several NPCs may reach the same food, eating is resolved once all collisions are handled
+    interactions->eats.push_back({npc->entityId(), food->entityId()});
+}
+
+void CollisionHandler::commitEat(World* world, NPC* npc, Food* food)
+{
     double inventorySpace = npc->_inventoryWeightCap-npc->_foodInInventory;
     if (inventorySpace > food->_nutritionalValue) {
         // The entire food entity is picked up and stored in the inventory
@@ -86,7 +92,7 @@ void CollisionHandler::handleCollision(World* world, NPC* npc, Food* food)
     }
 }
 
-void CollisionHandler::handleCollision(World* world, Food* food1, Food* food2)
+void CollisionHandler::handleCollision(World* world, Interactions* interactions, Food* food1, Food* food2)
 {
     {   // Physics collision
         Vec2f fromOther = food1->component<Orientation>().getPosition() - food2->component<Orientation>().getPosition();
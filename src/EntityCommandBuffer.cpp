@@ -0,0 +1,68 @@
+//
+// Project: rpg_world_simulator
+// File: EntityCommandBuffer.cpp
+//
+// Copyright (c) 2024 Miika 'Lehdari' Lehtimäki
+// You may use, distribute and modify this code under the terms
+// of the licence specified in file LICENSE which is distributed
+// with this source code package.
+//
+
+#include "EntityCommandBuffer.hpp"
+
+#include <algorithm>
+
+
+void EntityCommandBuffer::remove(EntityId id)
+{
+    EntityId expected = notRemoved;
+    if (!std::atomic_ref<EntityId>(_removedIds[entityIndex(id)]).compare_exchange_strong(
+        expected, id, std::memory_order_relaxed))
+        return; // already removed
+
+    std::lock_guard<std::mutex> lock(_mutex);
+    _removed.push_back(id);
+}
+
+void EntityCommandBuffer::create(std::function<void()>&& creator)
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    _creators.emplace_back(std::move(creator));
+}
+
+bool EntityCommandBuffer::isRemoved(EntityId id) const
+{
+    EntityId index = entityIndex(id);
+    return index < _removedIds.size() &&
+        std::atomic_ref<EntityId>(const_cast<EntityId&>(_removedIds[index])).load(std::memory_order_relaxed) == id;
+}
+
+const std::vector<EntityId>& EntityCommandBuffer::getRemoved() const
+{
+    return _removed;
+}
+
+void EntityCommandBuffer::sortRemoved()
+{
+    std::sort(_removed.begin(), _removed.end());
+}
+
+void EntityCommandBuffer::apply()
+{
+    for (auto id : _removed)
+        _removedIds[entityIndex(id)] = notRemoved;
+    _removed.clear();
+
+    // Creators may queue more creators
+    for (std::size_t i=0; i<_creators.size(); ++i) {
+        auto creator = std::move(_creators[i]);
+        creator();
+    }
+    _creators.clear();
+}
+
+void EntityCommandBuffer::reserve(std::size_t nEntitySlots)
+{
+    if (_removedIds.size() < nEntitySlots)
+        _removedIds.resize(nEntitySlots, notRemoved);
+}
@@ -13,8 +13,25 @@
 #include "Orientation.hpp"
 
 
+EntityFinder::Worker::Worker(const EntityFinder& entityFinder) :
+    point   (entityFinder.point),
+    radius  (entityFinder.radius)
+{
+}
+
+void EntityFinder::Worker::operator()(EntityId id, Label& label, Orientation& orientation)
+{
+    if ((point-orientation.getPosition()).squaredNorm() <= radius*radius)
+        entityHandles.emplace_back(id, label.entityTypeId);
+}
+
 void EntityFinder::operator()(EntityId id, Label& label, Orientation& orientation)
 {
     if ((point-orientation.getPosition()).squaredNorm() <= radius*radius)
         entityHandles->emplace_back(id, label.entityTypeId);
 }
+
+void EntityFinder::merge(Worker& worker)
+{
+    entityHandles->insert(entityHandles->end(), worker.entityHandles.begin(), worker.entityHandles.end());
+}
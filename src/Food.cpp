@@ -9,10 +9,11 @@
 //
 
 #include "Food.hpp"
+#include "World.hpp"
 
 
-ENTITY_CONSTRUCTOR(Food, const Vec2f& position),
-    _nutritionalValue   (0.05 + rnd(0.0, 0.15))
+ENTITY_CONSTRUCTOR(Food, const Vec2f& position, uint64_t seed, uint64_t tick),
+    _nutritionalValue   (0.05 + Random(seed, tick, entityId(), Random::Create).uniform(0.0, 0.15))
 {
     component<Label>().entityTypeId = entityTypeId<Food>();
 
@@ -25,10 +26,10 @@ ENTITY_CONSTRUCTOR(Food, const Vec2f& position),
     updateRadius();
 }
 
-void Food::update(World* world)
+void Food::update(World* world, float growth)
 {
     if (_nutritionalValue < 2.0)
-        _nutritionalValue += rnd(0.0, 0.001);
+        _nutritionalValue += growth;
     updateRadius();
 }
 
@@ -0,0 +1,17 @@
+//
+// Project: rpg_world_simulator
+// File: Interactions.cpp
+//
+// Copyright (c) 2024 Miika 'Lehdari' Lehtimäki
+// You may use, distribute and modify this code under the terms
+// of the licence specified in file LICENSE which is distributed
+// with this source code package.
+//
+
+#include "Interactions.hpp"
+
+
+void Interactions::clear()
+{
+    eats.clear();
+}
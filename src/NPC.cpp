@@ -9,9 +9,9 @@
 //
 
 #include "NPC.hpp"
-#include "SpriteRenderer.hpp"
 #include "World.hpp"
 #include "Food.hpp"
+#include "Tracer.hpp"
 
 #include <algorithm>
 
@@ -19,18 +19,22 @@
 static constexpr double maxHealth = 100.0;
 
 
-ENTITY_CONSTRUCTOR(NPC, const Vec2f& position),
-    _speed              (rnd(-0.002, 0.02)),
+ENTITY_CONSTRUCTOR(NPC, const Vec2f& position, uint64_t seed, uint64_t tick),
+    _speed              (0.0),
+    _velocity           (Vec2f::Zero()),
     _health             (maxHealth),
     _maxEnergy          (100.0),
     _energy             (_maxEnergy),
     _inventoryWeightCap (1.0),
     _foodInInventory    (0.0)
 {
+    Random random(seed, tick, entityId(), Random::Create);
+    _speed = random.uniform(-0.002, 0.02);
+
     component<Label>().entityTypeId = entityTypeId<NPC>();
 
     component<Orientation>().setPosition(position);
-    component<Orientation>().setRotation(rnd<float>(0.0f, 2.0f*PI));
+    component<Orientation>().setRotation(random.uniform(0.0f, 2.0f*(float)PI));
 
     component<Sprite>().setSpriteId(0);
     component<Sprite>().setOrigin(Vec2f(64.0f, 64.0f));
@@ -41,33 +45,22 @@ ENTITY_CONSTRUCTOR(NPC, const Vec2f& position),
 
 void NPC::update(World* world)
 {
+    TRACE_SCOPE("NPC::update");
     auto& position = component<Orientation>().getPosition();
+    Random random = world->getRandom(entityId(), Random::Update);
 
-    // Find nearest food
-    static std::vector<std::pair<EntityId, TypeId>> nearbyEntities;
-    nearbyEntities.clear();
-    world->getEntitiesWithinRadius(position, 4.0, &nearbyEntities);
-    float distanceSqrToNearest = -1.0f;
-    Food* nearestFood = nullptr;
-    for (const auto& eInfo : nearbyEntities) {
-        if (eInfo.second == entityTypeId<Food>()) {
-            auto food = static_cast<Food*>(world->componentPool->getEntityHandle(eInfo.first));
-            float distanceSqr = (food->component<Orientation>().getPosition() - position).squaredNorm();
-            if (distanceSqrToNearest < 0.0f || distanceSqr < distanceSqrToNearest) {
-                nearestFood = food;
-                distanceSqrToNearest = distanceSqr;
-            }
-        }
-    }
+    // Find nearest food, read from the spatial grid as other entities may be updated concurrently
+    Vec2f foodPosition;
+    Food* nearestFood = world->findNearest<Food>(position, 4.0, &foodPosition);
 
-    _speed = std::clamp(_speed + rnd(-0.001, 0.0011), -0.005, 0.05);
+    _speed = std::clamp(_speed + random.uniform(-0.001, 0.0011), -0.005, 0.05);
     if (nearestFood == nullptr) {
         // Random movement (for now)
-        component<Orientation>().rotate(rnd(-0.05, 0.05));
+        component<Orientation>().rotate(random.uniform(-0.05, 0.05));
     }
     else {
         // Move towards the nearest food
-        Vec2f toFood = nearestFood->component<Orientation>().getPosition() - position;
+        Vec2f toFood = foodPosition - position;
         component<Orientation>().setRotation(atan2(toFood(1), toFood(0)));
     }
 
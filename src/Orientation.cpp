@@ -92,3 +92,14 @@ void Orientation::updateOrientation()
         _rotSin*_scale, _rotCos*_scale,     _position(1),
         0.0f,           0.0f,               1.0f;
 }
+
+
+Orientation interpolate(const Orientation& from, const Orientation& to, float alpha)
+{
+    // Rotations are not wrapped, take the shortest way around
+    float rotationDelta = std::remainder(to.getRotation() - from.getRotation(), 2.0f*(float)PI);
+    return Orientation(
+        from.getPosition() + alpha*(to.getPosition()-from.getPosition()),
+        from.getRotation() + alpha*rotationDelta,
+        from.getScale() + alpha*(to.getScale()-from.getScale()));
+}
@@ -0,0 +1,30 @@
+//
+// Project: rpg_world_simulator
+// File: OrientationHistory.cpp
+//
+// Copyright (c) 2024 Miika 'Lehdari' Lehtimäki
+// You may use, distribute and modify this code under the terms
+// of the licence specified in file LICENSE which is distributed
+// with this source code package.
+//
+
+#include "OrientationHistory.hpp"
+
+
+void OrientationHistory::operator()(EntityId id, Orientation& orientation)
+{
+    EntityId index = entityIndex(id);
+    if (index >= _entries.size())
+        _entries.resize(index+1, Entry{(EntityId)-1, Orientation()});
+
+    _entries[index] = Entry{id, orientation};
+}
+
+const Orientation& OrientationHistory::getRecorded(EntityId id, const Orientation& current) const
+{
+    EntityId index = entityIndex(id);
+    if (index >= _entries.size() || _entries[index].id != id)
+        return current;
+
+    return _entries[index].orientation;
+}
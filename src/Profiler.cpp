@@ -0,0 +1,69 @@
+//
+// Project: rpg_world_simulator
+// File: Profiler.cpp
+//
+// Copyright (c) 2024 Miika 'Lehdari' Lehtimäki
+// You may use, distribute and modify this code under the terms
+// of the licence specified in file LICENSE which is distributed
+// with this source code package.
+//
+
+#include "Profiler.hpp"
+
+#include <algorithm>
+
+
+Profiler& Profiler::instance()
+{
+    static Profiler profiler;
+    return profiler;
+}
+
+Profiler::StageId Profiler::addStage(const std::string& name)
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    for (StageId i=0; i<_stages.size(); ++i) {
+        if (_stages[i].name == name)
+            return i;
+    }
+
+    _stages.push_back(Stage{name, {}, 0});
+    return _stages.size()-1;
+}
+
+void Profiler::addSample(StageId stageId, Clock::duration duration)
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    auto& stage = _stages[stageId];
+    stage.durations[stage.nSamples % historySize] =
+        std::chrono::duration<float, std::milli>(duration).count();
+    ++stage.nSamples;
+}
+
+std::vector<Profiler::StageStatistics> Profiler::getStatistics() const
+{
+    std::vector<StageStatistics> statistics;
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        statistics.reserve(_stages.size());
+        for (const auto& stage : _stages) {
+            auto& stageStatistics = statistics.emplace_back(StageStatistics{stage.name, {}, 0.0f, 0.0f});
+            std::size_t nDurations = std::min(stage.nSamples, historySize);
+            for (std::size_t i=stage.nSamples-nDurations; i<stage.nSamples; ++i)
+                stageStatistics.durations.push_back(stage.durations[i % historySize]);
+        }
+    }
+
+    std::vector<float> sorted;
+    for (auto& stageStatistics : statistics) {
+        if (stageStatistics.durations.empty())
+            continue;
+
+        sorted = stageStatistics.durations;
+        std::sort(sorted.begin(), sorted.end());
+        stageStatistics.p50 = sorted[(sorted.size()-1)*50/100];
+        stageStatistics.p99 = sorted[(sorted.size()-1)*99/100];
+    }
+
+    return statistics;
+}
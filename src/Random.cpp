@@ -0,0 +1,122 @@
+//
+// Project: rpg_world_simulator
+// File: Random.cpp
+//
+// Copyright (c) 2024 Miika 'Lehdari' Lehtimäki
+// You may use, distribute and modify this code under the terms
+// of the licence specified in file LICENSE which is distributed
+// with this source code package.
+//
+
+#include "Random.hpp"
+
+#include <algorithm>
+
+
+static constexpr uint32_t philoxMultiplier0    = 0xD2511F53;
+static constexpr uint32_t philoxMultiplier1    = 0xCD9E8D57;
+static constexpr uint32_t philoxWeyl0          = 0x9E3779B9;
+static constexpr uint32_t philoxWeyl1          = 0xBB67AE85;
+static constexpr int philoxRounds = 10;
+
+// Counter layout: entity index, entity generation, tick (modulo 2^32), stream in the upper
+// and block number in the lower 16 bits. The key is the world seed.
+static inline void initCounter(uint32_t* counter, uint64_t tick, EntityId id, uint32_t stream)
+{
+    counter[0] = (uint32_t)entityIndex(id);
+    counter[1] = entityGeneration(id);
+    counter[2] = (uint32_t)tick;
+    counter[3] = stream << 16;
+}
+
+static inline void philoxRound(uint32_t& c0, uint32_t& c1, uint32_t& c2, uint32_t& c3, uint32_t k0, uint32_t k1)
+{
+    uint64_t product0 = (uint64_t)philoxMultiplier0 * c0;
+    uint64_t product1 = (uint64_t)philoxMultiplier1 * c2;
+    uint32_t n0 = (uint32_t)(product1 >> 32) ^ c1 ^ k0;
+    uint32_t n2 = (uint32_t)(product0 >> 32) ^ c3 ^ k1;
+    c1 = (uint32_t)product1;
+    c3 = (uint32_t)product0;
+    c0 = n0;
+    c2 = n2;
+}
+
+static inline float toFloat(uint32_t x, float min, float max)
+{
+    // 24 bits, exactly representable in [0, 1)
+    return min + (max-min)*((float)(x >> 8) * 0x1.0p-24f);
+}
+
+
+Random::Random(uint64_t seed, uint64_t tick, EntityId id, uint32_t stream) :
+    _key            {(uint32_t)seed, (uint32_t)(seed >> 32)},
+    _block          {0, 0, 0, 0},
+    _blockPosition  (4)
+{
+    initCounter(_counter.data(), tick, id, stream);
+}
+
+uint32_t Random::next()
+{
+    if (_blockPosition == 4) {
+        _block = _counter;
+        uint32_t k0 = _key[0];
+        uint32_t k1 = _key[1];
+        for (int i=0; i<philoxRounds; ++i) {
+            philoxRound(_block[0], _block[1], _block[2], _block[3], k0, k1);
+            k0 += philoxWeyl0;
+            k1 += philoxWeyl1;
+        }
+        ++_counter[3];
+        _blockPosition = 0;
+    }
+    return _block[_blockPosition++];
+}
+
+float Random::uniform(float min, float max)
+{
+    return toFloat(next(), min, max);
+}
+
+double Random::uniform(double min, double max)
+{
+    // 53 bits from two numbers, drawn in a fixed order as operand evaluation order is unspecified
+    uint64_t hi = next();
+    uint64_t lo = next();
+    uint64_t x = (hi << 21) ^ (lo >> 11);
+    return min + (max-min)*((double)x * 0x1.0p-53);
+}
+
+void Random::uniformBatch(uint64_t seed, uint64_t tick, uint32_t stream, const EntityId* ids,
+    std::size_t count, float min, float max, float* out)
+{
+    // Structure of arrays over a fixed number of lanes so that the rounds vectorize
+    constexpr std::size_t nLanes = 16;
+    uint32_t c0[nLanes], c1[nLanes], c2[nLanes], c3[nLanes];
+    uint32_t key0 = (uint32_t)seed;
+    uint32_t key1 = (uint32_t)(seed >> 32);
+
+    for (std::size_t first=0; first<count; first+=nLanes) {
+        std::size_t nActive = std::min(nLanes, count-first);
+        for (std::size_t l=0; l<nLanes; ++l) {
+            uint32_t counter[4];
+            initCounter(counter, tick, ids[first + std::min(l, nActive-1)], stream);
+            c0[l] = counter[0];
+            c1[l] = counter[1];
+            c2[l] = counter[2];
+            c3[l] = counter[3];
+        }
+
+        uint32_t k0 = key0;
+        uint32_t k1 = key1;
+        for (int i=0; i<philoxRounds; ++i) {
+            for (std::size_t l=0; l<nLanes; ++l)
+                philoxRound(c0[l], c1[l], c2[l], c3[l], k0, k1);
+            k0 += philoxWeyl0;
+            k1 += philoxWeyl1;
+        }
+
+        for (std::size_t l=0; l<nActive; ++l)
+            out[first+l] = toFloat(c0[l], min, max);
+    }
+}
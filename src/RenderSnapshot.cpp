@@ -0,0 +1,238 @@
+//
+// Project: rpg_world_simulator
+// File: RenderSnapshot.cpp
+//
+// Copyright (c) 2024 Miika 'Lehdari' Lehtimäki
+// You may use, distribute and modify this code under the terms
+// of the licence specified in file LICENSE which is distributed
+// with this source code package.
+//
+
+#include "RenderSnapshot.hpp"
+#include "OrientationHistory.hpp"
+
+#include <algorithm>
+#include <limits>
+
+
+// Cell coordinates are clamped to this, differences of clamped coordinates do not overflow
+static constexpr int32_t maxCellCoordinate = 1 << 29;
+
+
+RenderSnapshot::RenderSnapshot(float cellSize) :
+    _cellSize           (cellSize),
+    _cellSizeInv        (1.0f / cellSize),
+    _xMin               (0),
+    _yMin               (0),
+    _width              (0),
+    _height             (0),
+    _maxScale           (0.0f),
+    _maxOrigin          (0.0f),
+    _maxDisplacement    (0.0f)
+{
+}
+
+void RenderSnapshot::clear()
+{
+    _added.clear();
+    _instances.clear();
+    _cellStarts.clear();
+    _overflow.clear();
+    _width = 0;
+    _height = 0;
+    _maxScale = 0.0f;
+    _maxOrigin = 0.0f;
+    _maxDisplacement = 0.0f;
+}
+
+void RenderSnapshot::add(const Sprite& sprite, const Orientation& previous, const Orientation& current)
+{
+    // Instances with non-finite positions cannot be placed or rendered
+    if (!current.getPosition().allFinite() || !previous.getPosition().allFinite())
+        return;
+
+    _added.push_back(Instance{sprite, previous, current});
+
+    float spriteScale = sprite.getScale().cwiseAbs().maxCoeff();
+    _maxScale = std::max(_maxScale,
+        std::max(std::abs(previous.getScale()), std::abs(current.getScale()))*spriteScale);
+    _maxOrigin = std::max(_maxOrigin, sprite.getOrigin().norm());
+    _maxDisplacement = std::max(_maxDisplacement, (current.getPosition()-previous.getPosition()).norm());
+}
+
+void RenderSnapshot::build()
+{
+    _instances.clear();
+    _cellStarts.clear();
+    _overflow.clear();
+    _width = 0;
+    _height = 0;
+    if (_added.empty())
+        return;
+
+    // Fit the grid to the bounding box of the current positions, limited to maxGridSize cells per axis
+    _addedCoordinates.resize(_added.size());
+    for (std::size_t i=0; i<_added.size(); ++i)
+        _addedCoordinates[i] = cellCoordinate(_added[i].current.getPosition()(0));
+    fitAxis(_addedCoordinates, _xMin, _width);
+    for (std::size_t i=0; i<_added.size(); ++i)
+        _addedCoordinates[i] = cellCoordinate(_added[i].current.getPosition()(1));
+    fitAxis(_addedCoordinates, _yMin, _height);
+
+    // Counting sort of the instances by cell, instances outside the grid go to the overflow list
+    constexpr uint32_t overflowCell = std::numeric_limits<uint32_t>::max();
+    _cellStarts.assign((std::size_t)_width*_height + 1, 0);
+    _addedCells.resize(_added.size());
+    for (std::size_t i=0; i<_added.size(); ++i) {
+        const auto& p = _added[i].current.getPosition();
+        int32_t x = cellCoordinate(p(0))-_xMin;
+        int32_t y = cellCoordinate(p(1))-_yMin;
+        if (x < 0 || x >= _width || y < 0 || y >= _height) {
+            _addedCells[i] = overflowCell;
+            _overflow.push_back(_added[i]);
+            continue;
+        }
+        uint32_t cell = y*_width + x;
+        _addedCells[i] = cell;
+        ++_cellStarts[cell+1];
+    }
+    for (std::size_t i=1; i<_cellStarts.size(); ++i)
+        _cellStarts[i] += _cellStarts[i-1];
+
+    _instances.resize(_cellStarts.back());
+    _cellFill.assign(_cellStarts.begin(), _cellStarts.end()-1);
+    for (std::size_t i=0; i<_added.size(); ++i) {
+        if (_addedCells[i] != overflowCell)
+            _instances[_cellFill[_addedCells[i]]++] = _added[i];
+    }
+
+    // Cell summaries for aggregated rendering
+    _cellAggregates.assign((std::size_t)_width*_height, CellAggregate{Vec3f(0.0f, 0.0f, 0.0f), 0.0f});
+    for (std::size_t i=0; i<_added.size(); ++i) {
+        if (_addedCells[i] == overflowCell)
+            continue;
+        const auto& instance = _added[i];
+        auto& aggregate = _cellAggregates[_addedCells[i]];
+        float scale = instance.current.getScale();
+        aggregate.color += instance.sprite.getColor();
+        aggregate.spriteArea += std::abs(instance.sprite.getScale().prod())*scale*scale;
+    }
+    for (std::size_t cell=0; cell<_cellAggregates.size(); ++cell) {
+        uint32_t count = _cellStarts[cell+1] - _cellStarts[cell];
+        if (count > 0)
+            _cellAggregates[cell].color /= (float)count;
+    }
+}
+
+bool RenderSnapshot::getCellRange(const Vec2f& min, const Vec2f& max, CellRange& range) const
+{
+    if (_instances.empty())
+        return false;
+
+    range.x1 = std::max(cellCoordinate(min(0)) - _xMin, 0);
+    range.x2 = std::min(cellCoordinate(max(0)) - _xMin, _width-1);
+    range.y1 = std::max(cellCoordinate(min(1)) - _yMin, 0);
+    range.y2 = std::min(cellCoordinate(max(1)) - _yMin, _height-1);
+    return range.x1 <= range.x2 && range.y1 <= range.y2;
+}
+
+const RenderSnapshot::CellAggregate& RenderSnapshot::getCellAggregate(int32_t x, int32_t y) const
+{
+    return _cellAggregates[y*_width + x];
+}
+
+Vec2f RenderSnapshot::getCellMin(int32_t x, int32_t y) const
+{
+    return Vec2f((float)(x+_xMin)*_cellSize, (float)(y+_yMin)*_cellSize);
+}
+
+float RenderSnapshot::getCellSize() const
+{
+    return _cellSize;
+}
+
+float RenderSnapshot::getMaxSpriteScale() const
+{
+    return _maxScale;
+}
+
+float RenderSnapshot::getBoundingRadius(float maxSpriteDiagonal) const
+{
+    return _maxScale*(_maxOrigin + maxSpriteDiagonal) + _maxDisplacement;
+}
+
+float RenderSnapshot::getInterpolationAlpha(Clock::time_point time) const
+{
+    if (tickTime <= 0.0)
+        return 1.0f;
+
+    double elapsed = std::chrono::duration<double>(time - publishTime).count();
+    return (float)std::clamp(elapsed / tickTime, 0.0, 1.0);
+}
+
+
+RenderSnapshotWriter::RenderSnapshotWriter(
+    RenderSnapshot* snapshot, const OrientationHistory* orientationHistory
+) :
+    _snapshot           (snapshot),
+    _orientationHistory (orientationHistory)
+{
+}
+
+void RenderSnapshotWriter::operator()(EntityId id, Sprite& sprite, Orientation& orientation)
+{
+    _snapshot->add(sprite, _orientationHistory->getRecorded(id, orientation), orientation);
+}
+
+
+int32_t RenderSnapshot::cellCoordinate(float x) const
+{
+    float c = std::floor(x * _cellSizeInv);
+    if (!(c > (float)-maxCellCoordinate)) // also catches NaN
+        return -maxCellCoordinate;
+    if (c >= (float)maxCellCoordinate)
+        return maxCellCoordinate;
+    return (int32_t)c;
+}
+
+void RenderSnapshot::fitAxis(std::vector<int32_t>& coordinates, int32_t& min, int32_t& size) const
+{
+    auto [minIt, maxIt] = std::minmax_element(coordinates.begin(), coordinates.end());
+    min = *minIt;
+    size = *maxIt - *minIt + 1;
+    if (size <= maxGridSize)
+        return;
+
+    // Too wide, center the grid on the median so that outliers end up in the overflow list
+    auto median = coordinates.begin() + coordinates.size()/2;
+    std::nth_element(coordinates.begin(), median, coordinates.end());
+    min = *median - maxGridSize/2;
+    size = maxGridSize;
+}
+
+
+RenderSnapshotBuffer::RenderSnapshotBuffer() :
+    _write  (0),
+    _read   (1),
+    _middle (2)
+{
+}
+
+RenderSnapshot& RenderSnapshotBuffer::getWriteSnapshot()
+{
+    return _snapshots[_write];
+}
+
+void RenderSnapshotBuffer::publish()
+{
+    // Release the written snapshot, acquire the one the consumer last gave away
+    _write = _middle.exchange(_write | freshBit, std::memory_order_acq_rel) & indexMask;
+}
+
+RenderSnapshot& RenderSnapshotBuffer::acquire()
+{
+    if (_middle.load(std::memory_order_relaxed) & freshBit)
+        _read = _middle.exchange(_read, std::memory_order_acq_rel) & indexMask;
+
+    return _snapshots[_read];
+}
@@ -0,0 +1,201 @@
+//
+// Project: rpg_world_simulator
+// File: Simulation.cpp
+//
+// Copyright (c) 2024 Miika 'Lehdari' Lehtimäki
+// You may use, distribute and modify this code under the terms
+// of the licence specified in file LICENSE which is distributed
+// with this source code package.
+//
+
+#include "Simulation.hpp"
+#include "Profiler.hpp"
+#include "Tracer.hpp"
+
+#include <algorithm>
+#include <cstdio>
+
+
+Simulation::Simulation() :
+    _world                  (&_componentPool),
+    _collisionHandler       (&_componentPool, &_world),
+    _quit                   (false),
+    _paused                 (false),
+    _ticksPerSecond         (60.0),
+    _achievedTicksPerSecond (0.0),
+    _parallelUpdates        (true),
+    _traceTicksRequested    (0),
+    _traceTicksLeft         (0)
+{
+}
+
+Simulation::~Simulation()
+{
+    stop();
+}
+
+void Simulation::start()
+{
+    if (_thread.joinable())
+        return;
+
+    _quit.store(false);
+    _thread = std::thread(&Simulation::run, this);
+}
+
+void Simulation::stop()
+{
+    if (!_thread.joinable())
+        return;
+
+    _quit.store(true);
+    _thread.join();
+}
+
+void Simulation::setPaused(bool paused)
+{
+    _paused.store(paused);
+}
+
+bool Simulation::isPaused() const
+{
+    return _paused.load();
+}
+
+void Simulation::setTicksPerSecond(double ticksPerSecond)
+{
+    _ticksPerSecond.store(std::max(ticksPerSecond, 1.0));
+}
+
+double Simulation::getTicksPerSecond() const
+{
+    return _ticksPerSecond.load();
+}
+
+double Simulation::getAchievedTicksPerSecond() const
+{
+    return _achievedTicksPerSecond.load();
+}
+
+void Simulation::setParallelUpdates(bool parallelUpdates)
+{
+    _parallelUpdates.store(parallelUpdates);
+}
+
+bool Simulation::getParallelUpdates() const
+{
+    return _parallelUpdates.load();
+}
+
+void Simulation::captureTrace(int nTicks)
+{
+    _traceTicksRequested.store(std::max(nTicks, 1));
+}
+
+int Simulation::getTraceTicksLeft() const
+{
+    return std::max(_traceTicksLeft.load(), _traceTicksRequested.load());
+}
+
+RenderSnapshotBuffer& Simulation::getRenderSnapshots()
+{
+    return _renderSnapshots;
+}
+
+void Simulation::run()
+{
+    Clock::time_point nextTick = Clock::now();
+    Clock::time_point rateStart = nextTick;
+    uint32_t nRateTicks = 0;
+
+    while (!_quit.load()) {
+        Clock::time_point now = Clock::now();
+
+        // Achieved tick rate over half a second periods
+        double rateElapsed = std::chrono::duration<double>(now - rateStart).count();
+        if (rateElapsed >= 0.5) {
+            _achievedTicksPerSecond.store((double)nRateTicks / rateElapsed);
+            rateStart = now;
+            nRateTicks = 0;
+        }
+
+        if (_paused.load()) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+            nextTick = Clock::now();
+            continue;
+        }
+
+        if (now < nextTick) {
+            // Wake up at least every millisecond to react to rate changes and stopping
+            std::this_thread::sleep_until(std::min(nextTick, now + std::chrono::milliseconds(1)));
+            continue;
+        }
+
+        double tickTime = 1.0 / _ticksPerSecond.load();
+        tick(tickTime);
+        ++nRateTicks;
+
+        nextTick += std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(tickTime));
+        if (std::chrono::duration<double>(now - nextTick).count() > maxBacklog)
+            nextTick = now;
+    }
+
+#ifdef RPG_WORLD_SIMULATOR_TRACING
+    if (_traceTicksLeft.exchange(0) > 0)
+        Tracer::instance().stop();
+#endif
+}
+
+void Simulation::tick(double tickTime)
+{
+    updateTrace();
+
+    // Orientations before the tick for interpolating between the snapshots
+    _componentPool.runSystem<OrientationHistory, Orientation>(&_orientationHistory);
+
+    {
+        PROFILE_SCOPE("World update");
+        _world.setUpdateMode(_parallelUpdates.load() ? World::UpdateMode::Parallel : World::UpdateMode::Serial);
+        _world.update(&_collisionHandler);
+    }
+
+    {
+        PROFILE_SCOPE("Render snapshot");
+        TRACE_SCOPE("Render snapshot");
+        auto& snapshot = _renderSnapshots.getWriteSnapshot();
+        snapshot.clear();
+        RenderSnapshotWriter writer(&snapshot, &_orientationHistory);
+        _componentPool.runSystem<RenderSnapshotWriter, Sprite, Orientation>(&writer);
+        snapshot.build();
+        snapshot.tickTime = tickTime;
+        snapshot.publishTime = Clock::now();
+        _renderSnapshots.publish();
+    }
+}
+
+void Simulation::updateTrace()
+{
+#ifdef RPG_WORLD_SIMULATOR_TRACING
+    // Stop after the requested number of ticks
+    int traceTicksLeft = _traceTicksLeft.load();
+    if (traceTicksLeft > 0) {
+        _traceTicksLeft.store(--traceTicksLeft);
+        if (traceTicksLeft == 0) {
+            Tracer::instance().stop();
+            if (Tracer::instance().write(traceFileName))
+                printf("Trace written to %s\n", traceFileName);
+            else
+                printf("Error: Could not write %s\n", traceFileName);
+        }
+    }
+
+    // Start a requested capture from the next tick on
+    int traceTicksRequested = _traceTicksRequested.exchange(0);
+    if (traceTicksRequested > 0 && _traceTicksLeft.load() == 0) {
+        Tracer::instance().start();
+        _traceTicksLeft.store(traceTicksRequested);
+    }
+#else
+    _traceTicksRequested.store(0);
+#endif
+}
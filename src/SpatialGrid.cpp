@@ -0,0 +1,135 @@
+//
+// Project: rpg_world_simulator
+// File: SpatialGrid.cpp
+//
+// Copyright (c) 2024 Miika 'Lehdari' Lehtimäki
+// You may use, distribute and modify this code under the terms
+// of the licence specified in file LICENSE which is distributed
+// with this source code package.
+//
+
+#include "SpatialGrid.hpp"
+#include "Label.hpp"
+#include "Orientation.hpp"
+
+#include <limits>
+
+
+// Cell coordinates are clamped to this, differences of clamped coordinates do not overflow
+static constexpr int32_t maxCellCoordinate = 1 << 29;
+
+
+SpatialGrid::SpatialGrid(float cellSize) :
+    _cellSize       (cellSize),
+    _cellSizeInv    (1.0f / cellSize),
+    _xMin           (0),
+    _yMin           (0),
+    _width          (0),
+    _height         (0)
+{
+}
+
+void SpatialGrid::setCellSize(float cellSize)
+{
+    _cellSize = cellSize;
+    _cellSizeInv = 1.0f / cellSize;
+}
+
+float SpatialGrid::getCellSize() const
+{
+    return _cellSize;
+}
+
+void SpatialGrid::clear()
+{
+    _gathered.clear();
+    _entries.clear();
+    _cellStarts.clear();
+    _overflow.clear();
+    _width = 0;
+    _height = 0;
+}
+
+void SpatialGrid::operator()(EntityId id, Label& label, Orientation& orientation)
+{
+    // Entities with non-finite positions cannot be found by any query
+    if (orientation.getPosition().allFinite())
+        _gathered.push_back({id, label.entityTypeId, orientation.getPosition()});
+}
+
+void SpatialGrid::build()
+{
+    _entries.clear();
+    _cellStarts.clear();
+    _overflow.clear();
+    _width = 0;
+    _height = 0;
+    if (_gathered.empty())
+        return;
+
+    // Fit the grid to the bounding box of the gathered positions, limited to maxGridSize cells per axis
+    _gatheredCoordinates.resize(_gathered.size());
+    for (std::size_t i=0; i<_gathered.size(); ++i)
+        _gatheredCoordinates[i] = cellCoordinate(_gathered[i].position(0));
+    fitAxis(_gatheredCoordinates, _xMin, _width);
+    for (std::size_t i=0; i<_gathered.size(); ++i)
+        _gatheredCoordinates[i] = cellCoordinate(_gathered[i].position(1));
+    fitAxis(_gatheredCoordinates, _yMin, _height);
+
+    // Counting sort of the entries by cell, entries outside the grid go to the overflow list
+    constexpr uint32_t overflowCell = std::numeric_limits<uint32_t>::max();
+    _cellStarts.assign((std::size_t)_width*_height + 1, 0);
+    _gatheredCells.resize(_gathered.size());
+    for (std::size_t i=0; i<_gathered.size(); ++i) {
+        const auto& p = _gathered[i].position;
+        int32_t x = cellCoordinate(p(0))-_xMin;
+        int32_t y = cellCoordinate(p(1))-_yMin;
+        if (x < 0 || x >= _width || y < 0 || y >= _height) {
+            _gatheredCells[i] = overflowCell;
+            _overflow.push_back(_gathered[i]);
+            continue;
+        }
+        uint32_t cell = y*_width + x;
+        _gatheredCells[i] = cell;
+        ++_cellStarts[cell+1];
+    }
+    for (std::size_t i=1; i<_cellStarts.size(); ++i)
+        _cellStarts[i] += _cellStarts[i-1];
+
+    _entries.resize(_cellStarts.back());
+    _cellFill.assign(_cellStarts.begin(), _cellStarts.end()-1);
+    for (std::size_t i=0; i<_gathered.size(); ++i) {
+        if (_gatheredCells[i] != overflowCell)
+            _entries[_cellFill[_gatheredCells[i]]++] = _gathered[i];
+    }
+}
+
+std::size_t SpatialGrid::size() const
+{
+    return _entries.size() + _overflow.size();
+}
+
+int32_t SpatialGrid::cellCoordinate(float x) const
+{
+    float c = std::floor(x * _cellSizeInv);
+    if (!(c > (float)-maxCellCoordinate)) // also catches NaN
+        return -maxCellCoordinate;
+    if (c >= (float)maxCellCoordinate)
+        return maxCellCoordinate;
+    return (int32_t)c;
+}
+
+void SpatialGrid::fitAxis(std::vector<int32_t>& coordinates, int32_t& min, int32_t& size) const
+{
+    auto [minIt, maxIt] = std::minmax_element(coordinates.begin(), coordinates.end());
+    min = *minIt;
+    size = *maxIt - *minIt + 1;
+    if (size <= maxGridSize)
+        return;
+
+    // Too wide, center the grid on the median so that outliers end up in the overflow list
+    auto median = coordinates.begin() + coordinates.size()/2;
+    std::nth_element(coordinates.begin(), median, coordinates.end());
+    min = *median - maxGridSize/2;
+    size = maxGridSize;
+}
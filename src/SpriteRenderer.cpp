@@ -11,30 +11,72 @@
 #include "SpriteRenderer.hpp"
 #include "Sprite.hpp"
 #include "Orientation.hpp"
+#include "RenderSnapshot.hpp"
 #include "FileUtils.hpp"
+#include "Profiler.hpp"
+#include "Tracer.hpp"
 
 #include <gut_opengl/Texture.hpp>
 
+#include <algorithm>
+#include <cstddef>
+
+
+static constexpr GLsizei instanceStride = sizeof(SpriteRenderer::SpriteInstance);
+
+static void waitFence(GLsync& fence)
+{
+    if (fence == nullptr)
+        return;
+
+    while (glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, 1000000) == GL_TIMEOUT_EXPIRED);
+    glDeleteSync(fence);
+    fence = nullptr;
+}
+
 
 SpriteRenderer::SpriteRenderer() :
     _windowWidth            (1280),
     _windowHeight           (720),
+    _maxSpriteDiagonal      (0.0f),
+    _maxSpriteArea          (0.0f),
+    _streamingMode          (StreamingMode::PersistentMapped),
     _vertexArrayObjectId    (0),
-    _positionBufferId       (0),
-    _texCoordBufferId       (0),
-    _colorBufferId          (0)
+    _instanceBufferId       (0),
+    _streamBufferId         (0),
+    _streamMapping          (nullptr),
+    _streamRegionCapacity   (0),
+    _streamRegion           (0),
+    _streamRegionSize       (0),
+    _streamFences           {nullptr},
+    _lodThreshold           (2.0f),
+    _lodActive              (false),
+    _heatmapVertexArrayObjectId (0),
+    _heatmapTextureId       (0),
+    _heatmapTextureWidth    (0),
+    _heatmapTextureHeight   (0),
+    _heatmapWidth           (0),
+    _heatmapHeight          (0),
+    _heatmapMin             (0.0f, 0.0f),
+    _heatmapMax             (0.0f, 0.0f)
 {}
 
 SpriteRenderer::~SpriteRenderer()
 {
     if (_vertexArrayObjectId != 0)
         glDeleteVertexArrays(1, &_vertexArrayObjectId);
-    if (_positionBufferId != 0)
-        glDeleteBuffers(1, &_positionBufferId);
-    if (_texCoordBufferId != 0)
-        glDeleteBuffers(1, &_texCoordBufferId);
-    if (_colorBufferId != 0)
-        glDeleteBuffers(1, &_colorBufferId);
+    if (_instanceBufferId != 0)
+        glDeleteBuffers(1, &_instanceBufferId);
+    for (auto& fence : _streamFences) {
+        if (fence != nullptr)
+            glDeleteSync(fence);
+    }
+    if (_streamBufferId != 0)
+        glDeleteBuffers(1, &_streamBufferId); // unmaps
+    if (_heatmapVertexArrayObjectId != 0)
+        glDeleteVertexArrays(1, &_heatmapVertexArrayObjectId);
+    if (_heatmapTextureId != 0)
+        glDeleteTextures(1, &_heatmapTextureId);
 }
 
 void SpriteRenderer::init()
@@ -45,20 +87,41 @@ void SpriteRenderer::init()
     glGenVertexArrays(1, &_vertexArrayObjectId);
     glBindVertexArray(_vertexArrayObjectId);
 
-    //  upload the vertex data to GPU and set up the vertex attribute arrays
-    glGenBuffers(1, &_positionBufferId);
-    glGenBuffers(1, &_texCoordBufferId);
-    glGenBuffers(1, &_colorBufferId);
+    //  set up the per-instance vertex attributes, quads have no per-vertex attributes. All of them
+    //  are read from binding 0, to which the buffer of the streaming mode is bound when rendering.
+    glVertexAttribFormat(0, 2, GL_FLOAT, GL_FALSE, offsetof(SpriteInstance, position));
+    glVertexAttribFormat(1, 1, GL_FLOAT, GL_FALSE, offsetof(SpriteInstance, rotation));
+    glVertexAttribIFormat(2, 1, GL_UNSIGNED_INT, offsetof(SpriteInstance, spriteId));
+    glVertexAttribFormat(3, 2, GL_FLOAT, GL_FALSE, offsetof(SpriteInstance, scale));
+    glVertexAttribFormat(4, 2, GL_FLOAT, GL_FALSE, offsetof(SpriteInstance, origin));
+    glVertexAttribFormat(5, 4, GL_UNSIGNED_BYTE, GL_TRUE, offsetof(SpriteInstance, color));
+    for (GLuint i=0; i<6; ++i) {
+        glEnableVertexAttribArray(i);
+        glVertexAttribBinding(i, 0);
+    }
+    glVertexBindingDivisor(0, 1);
+
+    glGenBuffers(1, &_instanceBufferId);
+
+    //  heatmap quad is generated from the vertex indices, without attributes
+    _heatmapShader.load((shaderDir / "VS_Heatmap.glsl").string(), (shaderDir / "FS_Heatmap.glsl").string());
+    glGenVertexArrays(1, &_heatmapVertexArrayObjectId);
+    glGenTextures(1, &_heatmapTextureId);
+    glBindTexture(GL_TEXTURE_2D, _heatmapTextureId);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
 }
 
 SpriteSheetId SpriteRenderer::addSpriteSheetFromFile(
     const std::string& fileName, int spriteWidth, int spriteHeight)
 {
     _spriteSheets.emplace_back(fileName, spriteWidth, spriteHeight);
+    _maxSpriteDiagonal = std::max(_maxSpriteDiagonal, Vec2f((float)spriteWidth, (float)spriteHeight).norm());
+    _maxSpriteArea = std::max(_maxSpriteArea, (float)spriteWidth*(float)spriteHeight);
 
-    _spriteVertexPositions.resize(_spriteSheets.size());
-    _spriteVertexTexCoords.resize(_spriteSheets.size());
-    _spriteVertexColors.resize(_spriteSheets.size());
+    _spriteInstances.resize(_spriteSheets.size());
 
     return _spriteSheets.size()-1;
 }
@@ -74,93 +137,329 @@ void SpriteRenderer::setWindowSize(int windowWidth, int windowHeight)
     _windowHeight = windowHeight;
 }
 
+void SpriteRenderer::setStreamingMode(StreamingMode streamingMode)
+{
+    clear();
+    _streamingMode = streamingMode;
+}
+
+SpriteRenderer::StreamingMode SpriteRenderer::getStreamingMode() const
+{
+    return _streamingMode;
+}
+
+void SpriteRenderer::setLodThreshold(float lodThreshold)
+{
+    _lodThreshold = lodThreshold;
+}
+
+float SpriteRenderer::getLodThreshold() const
+{
+    return _lodThreshold;
+}
+
+bool SpriteRenderer::isLodActive() const
+{
+    return _lodActive;
+}
+
 void SpriteRenderer::render(const Mat3f& viewport)
 {
+    PROFILE_SCOPE("Sprite render");
+    TRACE_SCOPE("Sprite render");
     glBindVertexArray(_vertexArrayObjectId);
 
-    for (int i = 0; i < _spriteSheets.size(); ++i) {
-        auto& vertexPositions = _spriteVertexPositions[i];
-        auto& vertexTexCoords = _spriteVertexTexCoords[i];
-        auto& vertexColors = _spriteVertexColors[i];
+    // Uniforms shared by all sprite sheets
+    _shader.use();
+    _shader.setUniform("windowWidth", _windowWidth);
+    _shader.setUniform("windowHeight", _windowHeight);
+    _shader.setUniform("viewport", viewport);
+    _shader.setUniform("tex", 0);
 
-        glBindBuffer(GL_ARRAY_BUFFER, _positionBufferId);
-        glBufferData(GL_ARRAY_BUFFER,
-                     vertexPositions.size() * sizeof(Vec2f),
-                     vertexPositions.data(), GL_DYNAMIC_DRAW);
-        glEnableVertexAttribArray(0);
-        glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, 0, (GLvoid *) 0);
+    switch (_streamingMode) {
+        case StreamingMode::BufferData:
+            renderBufferData();
+            break;
+        case StreamingMode::PersistentMapped:
+            renderPersistentMapped();
+            break;
+    }
 
-        glBindBuffer(GL_ARRAY_BUFFER, _texCoordBufferId);
-        glBufferData(GL_ARRAY_BUFFER,
-                     vertexTexCoords.size() * sizeof(Vec2f),
-                     vertexTexCoords.data(), GL_DYNAMIC_DRAW);
-        glEnableVertexAttribArray(1);
-        glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, 0, (GLvoid *) 0);
+    if (_heatmapWidth > 0)
+        renderHeatmap(viewport);
+}
+
+void SpriteRenderer::addSnapshot(const RenderSnapshot& snapshot, float alpha,
+    const Vec2f& visibleMin, const Vec2f& visibleMax)
+{
+    // On-screen size of the largest sprites, the viewport is not rotated
+    float pixelsPerUnit = (float)_windowWidth / (visibleMax(0)-visibleMin(0));
+    _lodActive = snapshot.getMaxSpriteScale()*_maxSpriteDiagonal*pixelsPerUnit < _lodThreshold;
+    if (_lodActive) {
+        addHeatmap(snapshot, visibleMin, visibleMax);
+        return;
+    }
+
+    float margin = snapshot.getBoundingRadius(_maxSpriteDiagonal);
 
-        glBindBuffer(GL_ARRAY_BUFFER, _colorBufferId);
+    if (_streamingMode != StreamingMode::PersistentMapped) {
+        std::size_t nVisible = 0;
+        snapshot.forEachInRectangle(visibleMin, visibleMax, margin, [&](const RenderSnapshot::Instance& instance) {
+            addSpriteInstance(instance.sprite, interpolate(instance.previous, instance.current, alpha),
+                _spriteInstances[instance.sprite._spriteSheetId]);
+            ++nVisible;
+        });
+        TRACE_COUNTER("Visible sprites", nVisible);
+        return;
+    }
+
+    // Reserve a range for each sprite sheet and write the visible instances in place
+    std::vector<std::size_t> counts(_spriteSheets.size(), 0);
+    std::size_t nVisible = 0;
+    snapshot.forEachInRectangle(visibleMin, visibleMax, margin, [&](const RenderSnapshot::Instance& instance) {
+        ++counts[instance.sprite._spriteSheetId];
+        ++nVisible;
+    });
+    TRACE_COUNTER("Visible sprites", nVisible);
+    if (nVisible == 0)
+        return;
+
+    // Reserve all at once, growing the buffer would invalidate the earlier ranges
+    reserveStreamInstances(nVisible);
+    std::vector<SpriteInstance*> cursors(_spriteSheets.size(), nullptr);
+    for (SpriteSheetId i=0; i<_spriteSheets.size(); ++i) {
+        if (counts[i] > 0)
+            cursors[i] = allocateStreamInstances(i, counts[i]);
+    }
+
+    snapshot.forEachInRectangle(visibleMin, visibleMax, margin, [&](const RenderSnapshot::Instance& instance) {
+        auto& cursor = cursors[instance.sprite._spriteSheetId];
+        *cursor++ = makeSpriteInstance(instance.sprite, interpolate(instance.previous, instance.current, alpha));
+    });
+}
+
+void SpriteRenderer::clear()
+{
+    for (auto& instances : _spriteInstances)
+        instances.clear();
+    _drawRanges.clear();
+    _streamRegionSize = 0;
+    _heatmapWidth = 0;
+    _heatmapHeight = 0;
+}
+
+void SpriteRenderer::renderBufferData()
+{
+    glBindVertexBuffer(0, _instanceBufferId, 0, instanceStride);
+
+    for (SpriteSheetId i=0; i<_spriteSheets.size(); ++i) {
+        auto& instances = _spriteInstances[i];
+        if (instances.empty())
+            continue;
+
+        TRACE_BEGIN("Sprite upload");
+        glBindBuffer(GL_ARRAY_BUFFER, _instanceBufferId);
         glBufferData(GL_ARRAY_BUFFER,
-                     vertexColors.size() * sizeof(Vec3f),
-                     vertexColors.data(), GL_DYNAMIC_DRAW);
-        glEnableVertexAttribArray(2);
-        glVertexAttribPointer(2, 3, GL_FLOAT, GL_FALSE, 0, (GLvoid *) 0);
-
-        _shader.use();
-        _shader.setUniform("windowWidth", _windowWidth);
-        _shader.setUniform("windowHeight", _windowHeight);
-        _shader.setUniform("viewport", viewport);
-        _spriteSheets[i]._texture.bind();
-        _shader.setUniform("tex", 0);
-        glDrawArrays(GL_TRIANGLES, 0, vertexPositions.size());
-
-        vertexPositions.clear();
-        vertexTexCoords.clear();
-        vertexColors.clear();
+                     instances.size() * sizeof(SpriteInstance),
+                     instances.data(), GL_STREAM_DRAW);
+        TRACE_END("Sprite upload");
+
+        TRACE_BEGIN("Sprite draw");
+        useSpriteSheet(i);
+        // One 4 vertex triangle strip quad per instance
+        glDrawArraysInstanced(GL_TRIANGLE_STRIP, 0, 4, (GLsizei)instances.size());
+        TRACE_END("Sprite draw");
+
+        instances.clear();
     }
 }
 
-void SpriteRenderer::operator()(EntityId id, Sprite& sprite, Orientation& orientation)
-{
-    sprite.update(*this);
-
-    auto& vertexPositions = _spriteVertexPositions[sprite._spriteSheetId];
-    Mat3f orientationMatrix = orientation.getOrientation();
-    orientationMatrix(0,0) *= sprite._scale(0);
-    orientationMatrix(1,0) *= sprite._scale(0);
-    orientationMatrix(0,1) *= sprite._scale(1);
-    orientationMatrix(1,1) *= sprite._scale(1);
-    vertexPositions.emplace_back((orientationMatrix * sprite._positions[0]).block<2,1>(0,0));
-    vertexPositions.emplace_back((orientationMatrix * sprite._positions[1]).block<2,1>(0,0));
-    vertexPositions.emplace_back((orientationMatrix * sprite._positions[3]).block<2,1>(0,0));
-    vertexPositions.emplace_back((orientationMatrix * sprite._positions[3]).block<2,1>(0,0));
-    vertexPositions.emplace_back((orientationMatrix * sprite._positions[1]).block<2,1>(0,0));
-    vertexPositions.emplace_back((orientationMatrix * sprite._positions[2]).block<2,1>(0,0));
-
-    auto& vertexTexCoords = _spriteVertexTexCoords[sprite._spriteSheetId];
-    vertexTexCoords.emplace_back(sprite._texCoords[0]);
-    vertexTexCoords.emplace_back(sprite._texCoords[1]);
-    vertexTexCoords.emplace_back(sprite._texCoords[3]);
-    vertexTexCoords.emplace_back(sprite._texCoords[3]);
-    vertexTexCoords.emplace_back(sprite._texCoords[1]);
-    vertexTexCoords.emplace_back(sprite._texCoords[2]);
-
-    auto& vertexColors = _spriteVertexColors[sprite._spriteSheetId];
-    vertexColors.emplace_back(sprite._color);
-    vertexColors.emplace_back(sprite._color);
-    vertexColors.emplace_back(sprite._color);
-    vertexColors.emplace_back(sprite._color);
-    vertexColors.emplace_back(sprite._color);
-    vertexColors.emplace_back(sprite._color);
+void SpriteRenderer::renderPersistentMapped()
+{
+    // addSnapshot wrote the instances straight to the mapped buffer
+    if (_drawRanges.empty())
+        return;
+
+    TRACE_BEGIN("Sprite draw");
+    std::stable_sort(_drawRanges.begin(), _drawRanges.end(),
+        [](const DrawRange& a, const DrawRange& b) { return a.spriteSheetId < b.spriteSheetId; });
+    SpriteSheetId currentSpriteSheetId = -1;
+    std::size_t regionStart = _streamRegion*_streamRegionCapacity;
+    for (const auto& range : _drawRanges) {
+        if (range.spriteSheetId != currentSpriteSheetId) {
+            useSpriteSheet(range.spriteSheetId);
+            currentSpriteSheetId = range.spriteSheetId;
+        }
+        glBindVertexBuffer(0, _streamBufferId, (GLintptr)((regionStart+range.first)*sizeof(SpriteInstance)),
+            instanceStride);
+        glDrawArraysInstanced(GL_TRIANGLE_STRIP, 0, 4, (GLsizei)range.count);
+    }
+    TRACE_END("Sprite draw");
+
+    // The region can be written again once the GPU has finished drawing from it
+    _streamFences[_streamRegion] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    _streamRegion = (_streamRegion+1) % nStreamRegions;
+    _streamRegionSize = 0;
+    _drawRanges.clear();
 }
 
-void SpriteRenderer::clear()
+void SpriteRenderer::renderHeatmap(const Mat3f& viewport)
 {
-    for (int i = 0; i < _spriteSheets.size(); ++i) {
-        auto& vertexPositions = _spriteVertexPositions[i];
-        auto& vertexTexCoords = _spriteVertexTexCoords[i];
-        auto& vertexColors = _spriteVertexColors[i];
+    TRACE_BEGIN("Heatmap upload");
+    glBindTexture(GL_TEXTURE_2D, _heatmapTextureId);
+    if (_heatmapWidth != _heatmapTextureWidth || _heatmapHeight != _heatmapTextureHeight) {
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, _heatmapWidth, _heatmapHeight, 0,
+            GL_RGBA, GL_UNSIGNED_BYTE, _heatmapTexels.data());
+        _heatmapTextureWidth = _heatmapWidth;
+        _heatmapTextureHeight = _heatmapHeight;
+    }
+    else {
+        glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, _heatmapWidth, _heatmapHeight,
+            GL_RGBA, GL_UNSIGNED_BYTE, _heatmapTexels.data());
+    }
+    TRACE_END("Heatmap upload");
+
+    TRACE_BEGIN("Heatmap draw");
+    // Unit square to the heatmap rectangle in window coordinates
+    Mat3f heatmapToWorld;
+    heatmapToWorld <<
+        _heatmapMax(0)-_heatmapMin(0),  0.0f,                           _heatmapMin(0),
+        0.0f,                           _heatmapMax(1)-_heatmapMin(1),  _heatmapMin(1),
+        0.0f,                           0.0f,                           1.0f;
+    Mat3f transform = viewport * heatmapToWorld;
 
-        vertexPositions.clear();
-        vertexTexCoords.clear();
-        vertexColors.clear();
+    _heatmapShader.use();
+    _heatmapShader.setUniform("windowWidth", _windowWidth);
+    _heatmapShader.setUniform("windowHeight", _windowHeight);
+    _heatmapShader.setUniform("transform", transform);
+    _heatmapShader.setUniform("tex", 0);
+    glActiveTexture(GL_TEXTURE0);
+    glBindVertexArray(_heatmapVertexArrayObjectId);
+    glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
+    TRACE_END("Heatmap draw");
+
+    _heatmapWidth = 0;
+    _heatmapHeight = 0;
+}
+
+void SpriteRenderer::addHeatmap(
+    const RenderSnapshot& snapshot, const Vec2f& visibleMin, const Vec2f& visibleMax)
+{
+    RenderSnapshot::CellRange range;
+    if (!snapshot.getCellRange(visibleMin, visibleMax, range))
+        return;
+
+    _heatmapWidth = range.x2-range.x1+1;
+    _heatmapHeight = range.y2-range.y1+1;
+    _heatmapMin = snapshot.getCellMin(range.x1, range.y1);
+    _heatmapMax = snapshot.getCellMin(range.x2+1, range.y2+1);
+    _heatmapTexels.resize((std::size_t)_heatmapWidth*_heatmapHeight*4);
+
+    // Opacity is the expected fraction of the cell covered by randomly placed sprites
+    float cellSize = snapshot.getCellSize();
+    float areaScale = _maxSpriteArea / (cellSize*cellSize);
+    auto toByte = [](float c) {
+        return (uint8_t)(std::clamp(c, 0.0f, 1.0f)*255.0f + 0.5f);
+    };
+    uint8_t* texel = _heatmapTexels.data();
+    for (int32_t y=range.y1; y<=range.y2; ++y) {
+        for (int32_t x=range.x1; x<=range.x2; ++x) {
+            const auto& aggregate = snapshot.getCellAggregate(x, y);
+            *texel++ = toByte(aggregate.color(0));
+            *texel++ = toByte(aggregate.color(1));
+            *texel++ = toByte(aggregate.color(2));
+            *texel++ = toByte(1.0f - std::exp(-aggregate.spriteArea*areaScale));
+        }
     }
 }
+
+void SpriteRenderer::useSpriteSheet(SpriteSheetId spriteSheetId)
+{
+    const auto& spriteSheet = _spriteSheets[spriteSheetId];
+    _shader.setUniform("spriteWidth", spriteSheet._spriteWidth);
+    _shader.setUniform("spriteHeight", spriteSheet._spriteHeight);
+    _shader.setUniform("nSpritesX", spriteSheet._nSpritesX);
+    _shader.setUniform("textureWidth", spriteSheet._texture.width());
+    _shader.setUniform("textureHeight", spriteSheet._texture.height());
+    spriteSheet._texture.bind();
+}
+
+void SpriteRenderer::reserveStreamInstances(std::size_t count)
+{
+    // First write to the region this frame, wait until the GPU is done with its previous contents
+    if (_streamRegionSize == 0)
+        waitFence(_streamFences[_streamRegion]);
+
+    if (_streamRegionSize + count > _streamRegionCapacity)
+        resizeStream(std::max({_streamRegionSize + count, 2*_streamRegionCapacity, (std::size_t)1024}));
+}
+
+SpriteRenderer::SpriteInstance* SpriteRenderer::allocateStreamInstances(
+    SpriteSheetId spriteSheetId, std::size_t count)
+{
+    reserveStreamInstances(count);
+
+    _drawRanges.push_back(DrawRange{spriteSheetId, _streamRegionSize, count});
+    SpriteInstance* instances = _streamMapping + _streamRegion*_streamRegionCapacity + _streamRegionSize;
+    _streamRegionSize += count;
+    return instances;
+}
+
+void SpriteRenderer::resizeStream(std::size_t regionCapacity)
+{
+    constexpr GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+    GLsizeiptr size = (GLsizeiptr)(nStreamRegions*regionCapacity*sizeof(SpriteInstance));
+
+    GLuint bufferId;
+    glGenBuffers(1, &bufferId);
+    glBindBuffer(GL_COPY_WRITE_BUFFER, bufferId);
+    glBufferStorage(GL_COPY_WRITE_BUFFER, size, nullptr, flags);
+    auto* mapping = (SpriteInstance*)glMapBufferRange(GL_COPY_WRITE_BUFFER, 0, size, flags);
+
+    if (_streamBufferId != 0) {
+        // Move the instances written this frame, the GPU keeps the old buffer alive as long as
+        // previous frames still draw from it
+        if (_streamRegionSize > 0) {
+            glBindBuffer(GL_COPY_READ_BUFFER, _streamBufferId);
+            glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER,
+                (GLintptr)(_streamRegion*_streamRegionCapacity*sizeof(SpriteInstance)),
+                (GLintptr)(_streamRegion*regionCapacity*sizeof(SpriteInstance)),
+                (GLsizeiptr)(_streamRegionSize*sizeof(SpriteInstance)));
+        }
+        glDeleteBuffers(1, &_streamBufferId);
+    }
+
+    // Fences of the old buffer do not concern the new one
+    for (auto& fence : _streamFences) {
+        if (fence != nullptr) {
+            glDeleteSync(fence);
+            fence = nullptr;
+        }
+    }
+
+    _streamBufferId = bufferId;
+    _streamMapping = mapping;
+    _streamRegionCapacity = regionCapacity;
+}
+
+void SpriteRenderer::addSpriteInstance(const Sprite& sprite, const Orientation& orientation,
+    Vector<SpriteInstance>& instances)
+{
+    instances.push_back(makeSpriteInstance(sprite, orientation));
+}
+
+SpriteRenderer::SpriteInstance SpriteRenderer::makeSpriteInstance(
+    const Sprite& sprite, const Orientation& orientation)
+{
+    auto toByte = [](float c) {
+        return (uint8_t)(std::clamp(c, 0.0f, 1.0f)*255.0f + 0.5f);
+    };
+
+    return SpriteInstance{
+        orientation.getPosition(),
+        orientation.getRotation(),
+        (uint32_t)sprite._spriteId,
+        orientation.getScale()*sprite._scale,
+        sprite._origin,
+        {toByte(sprite._color(0)), toByte(sprite._color(1)), toByte(sprite._color(2)), 255}};
+}
@@ -0,0 +1,139 @@
+//
+// Project: rpg_world_simulator
+// File: ThreadPool.cpp
+//
+// Copyright (c) 2024 Miika 'Lehdari' Lehtimäki
+// You may use, distribute and modify this code under the terms
+// of the licence specified in file LICENSE which is distributed
+// with this source code package.
+//
+
+#include "ThreadPool.hpp"
+#include "Tracer.hpp"
+
+#include <algorithm>
+
+
+static thread_local bool isPoolThread = false;
+
+
+ThreadPool::ThreadPool(std::size_t nThreads) :
+    _generation (0),
+    _quit       (false),
+    _task       (nullptr),
+    _nRemaining (0)
+{
+    if (nThreads == 0)
+        nThreads = std::max(std::thread::hardware_concurrency(), 1u);
+
+    for (std::size_t i=0; i<nThreads; ++i)
+        _queues.emplace_back(std::make_unique<Queue>());
+    for (std::size_t i=1; i<nThreads; ++i)
+        _threads.emplace_back(&ThreadPool::workerLoop, this, i);
+}
+
+ThreadPool::~ThreadPool()
+{
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _quit = true;
+    }
+    _condition.notify_all();
+    for (auto& thread : _threads)
+        thread.join();
+}
+
+std::size_t ThreadPool::getNumThreads() const
+{
+    return _queues.size();
+}
+
+void ThreadPool::parallelFor(std::size_t nChunks, const std::function<void(std::size_t)>& task)
+{
+    if (_threads.empty() || nChunks <= 1 || isPoolThread) {
+        for (std::size_t i=0; i<nChunks; ++i)
+            task(i);
+        return;
+    }
+
+    std::lock_guard<std::mutex> parallelForLock(_parallelForMutex);
+    isPoolThread = true;
+    _task = &task;
+    _nRemaining.store(nChunks, std::memory_order_relaxed);
+
+    // Contiguous blocks of chunks to each queue for locality, stealing balances the rest
+    std::size_t nQueues = _queues.size();
+    for (std::size_t q=0; q<nQueues; ++q) {
+        std::lock_guard<std::mutex> lock(_queues[q]->mutex);
+        for (std::size_t i=q*nChunks/nQueues; i<(q+1)*nChunks/nQueues; ++i)
+            _queues[q]->chunks.push_back(i);
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        ++_generation;
+    }
+    _condition.notify_all();
+
+    while (runChunk(0));
+    // Wait for the chunks still running on the other threads
+    while (_nRemaining.load(std::memory_order_acquire) > 0)
+        std::this_thread::yield();
+
+    _task = nullptr;
+    isPoolThread = false;
+}
+
+void ThreadPool::workerLoop(std::size_t queueId)
+{
+    isPoolThread = true;
+    uint64_t generation = 0;
+    for (;;) {
+        {
+            std::unique_lock<std::mutex> lock(_mutex);
+            _condition.wait(lock, [&]{ return _quit || _generation != generation; });
+            if (_quit)
+                return;
+            generation = _generation;
+        }
+
+        while (runChunk(queueId));
+    }
+}
+
+bool ThreadPool::runChunk(std::size_t queueId)
+{
+    std::size_t chunkId = 0;
+    bool found = false;
+
+    {   // Own queue from the front
+        auto& queue = *_queues[queueId];
+        std::lock_guard<std::mutex> lock(queue.mutex);
+        if (!queue.chunks.empty()) {
+            chunkId = queue.chunks.front();
+            queue.chunks.pop_front();
+            found = true;
+        }
+    }
+
+    // Steal from the back of the other queues
+    for (std::size_t i=1; !found && i<_queues.size(); ++i) {
+        auto& queue = *_queues[(queueId+i) % _queues.size()];
+        std::lock_guard<std::mutex> lock(queue.mutex);
+        if (!queue.chunks.empty()) {
+            chunkId = queue.chunks.back();
+            queue.chunks.pop_back();
+            found = true;
+        }
+    }
+
+    if (!found)
+        return false;
+
+    {
+        TRACE_SCOPE("Parallel chunk");
+        (*_task)(chunkId);
+    }
+    _nRemaining.fetch_sub(1, std::memory_order_acq_rel);
+    return true;
+}
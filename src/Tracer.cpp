@@ -0,0 +1,112 @@
+//
+// Project: rpg_world_simulator
+// File: Tracer.cpp
+//
+// Copyright (c) 2024 Miika 'Lehdari' Lehtimäki
+// You may use, distribute and modify this code under the terms
+// of the licence specified in file LICENSE which is distributed
+// with this source code package.
+//
+
+#include "Tracer.hpp"
+
+#include <cstdio>
+
+
+Tracer& Tracer::instance()
+{
+    static Tracer tracer;
+    return tracer;
+}
+
+void Tracer::start()
+{
+    {
+        std::lock_guard<std::mutex> lock(_buffersMutex);
+        for (auto& buffer : _buffers)
+            buffer->size.store(0, std::memory_order_relaxed);
+    }
+    _startTime = Clock::now();
+    _recording.store(true, std::memory_order_release);
+}
+
+void Tracer::stop()
+{
+    _recording.store(false, std::memory_order_release);
+}
+
+bool Tracer::isRecording() const
+{
+    return _recording.load(std::memory_order_relaxed);
+}
+
+void Tracer::begin(const char* name)
+{
+    record(name, 'B', 0);
+}
+
+void Tracer::end(const char* name)
+{
+    record(name, 'E', 0);
+}
+
+void Tracer::counter(const char* name, int64_t value)
+{
+    record(name, 'C', value);
+}
+
+bool Tracer::write(const std::string& fileName) const
+{
+    FILE* file = fopen(fileName.c_str(), "w");
+    if (file == nullptr)
+        return false;
+
+    fprintf(file, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n");
+    bool first = true;
+    std::lock_guard<std::mutex> lock(_buffersMutex);
+    for (const auto& buffer : _buffers) {
+        std::size_t size = buffer->size.load(std::memory_order_acquire);
+        for (std::size_t i=0; i<size; ++i) {
+            const auto& event = buffer->events[i];
+            fprintf(file, "%s{\"name\":\"%s\",\"ph\":\"%c\",\"pid\":0,\"tid\":%u,\"ts\":%.3f",
+                first ? "" : ",\n", event.name, event.phase, buffer->threadId, (double)event.time*1.0e-3);
+            if (event.phase == 'C')
+                fprintf(file, ",\"args\":{\"value\":%lld}", (long long)event.value);
+            fprintf(file, "}");
+            first = false;
+        }
+    }
+    fprintf(file, "\n]}\n");
+
+    return fclose(file) == 0;
+}
+
+void Tracer::record(const char* name, char phase, int64_t value)
+{
+    if (!_recording.load(std::memory_order_acquire))
+        return;
+
+    Buffer* buffer = threadBuffer();
+    std::size_t size = buffer->size.load(std::memory_order_relaxed);
+    if (size >= bufferCapacity)
+        return;
+
+    buffer->events[size] = Event{name, phase,
+        std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - _startTime).count(), value};
+    buffer->size.store(size+1, std::memory_order_release);
+}
+
+Tracer::Buffer* Tracer::threadBuffer()
+{
+    static thread_local Buffer* buffer = nullptr;
+    if (buffer == nullptr) {
+        // First event of the thread, register a new buffer
+        std::lock_guard<std::mutex> lock(_buffersMutex);
+        auto& newBuffer = _buffers.emplace_back(std::make_unique<Buffer>());
+        newBuffer->events = std::make_unique<Event[]>(bufferCapacity);
+        newBuffer->size.store(0, std::memory_order_relaxed);
+        newBuffer->threadId = (uint32_t)_buffers.size()-1;
+        buffer = newBuffer.get();
+    }
+    return buffer;
+}
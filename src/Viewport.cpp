@@ -72,6 +72,21 @@ Vec2f Viewport::toWorld(const Vec2f& position)
     return (_viewport.inverse() * Vec3f(position(0), position(1), 1.0)).block<2,1>(0,0);
 }
 
+void Viewport::getVisibleRectangle(Vec2f& worldMin, Vec2f& worldMax) const
+{
+    Mat3f inverse = _viewport.inverse();
+    worldMin = (inverse * Vec3f(0.0f, 0.0f, 1.0f)).block<2,1>(0,0);
+    worldMax = worldMin;
+    for (const auto& corner : {
+        Vec3f(_windowWidth, 0.0f, 1.0f),
+        Vec3f(0.0f, _windowHeight, 1.0f),
+        Vec3f(_windowWidth, _windowHeight, 1.0f) }) {
+        Vec2f p = (inverse * corner).block<2,1>(0,0);
+        worldMin = worldMin.cwiseMin(p);
+        worldMax = worldMax.cwiseMax(p);
+    }
+}
+
 float Viewport::getWindowWidth() const
 {
     return _windowWidth;
@@ -10,6 +10,8 @@
 
 #include <Window.hpp>
 #include <FileUtils.hpp>
+#include <Profiler.hpp>
+#include <Tracer.hpp>
 #include <imgui.h>
 #include <backends/imgui_impl_opengl3.h>
 #include "backends/imgui_impl_sdl2.h"
@@ -21,16 +23,14 @@ Window::Window(
     _settings               (settings),
     _window                 (nullptr),
     _quit                   (false),
-    _paused                 (false),
     _viewport               (_settings.window.width, _settings.window.height,
                              Vec2f(_settings.window.width*0.5f, _settings.window.height*0.5f), 32.0f),
     _cursorPosition         (0.0f, 0.0f),
     _renderMode             (1), // TODO set to 0
     _lastTicks              (0),
     _frameTicks             (0),
+    _traceTicks             (300),
     _windowContext          (*this),
-    _world                  (&_componentPool),
-    _collisionHandler       (&_componentPool, &_world),
     _spriteSheetId          (-1)
 {
     int err;
@@ -120,6 +120,7 @@ void Window::init(void)
 void Window::loop(void)
 {
     uint32_t frameId = 0;
+    _simulation.start();
 
     // Application main loop
     while (!_quit) {
@@ -133,16 +134,21 @@ void Window::loop(void)
         // Render
         glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
-        if (!_paused)
-            _world.update(&_collisionHandler);
-
 //        _creatureSystem.setStage(CreatureSystem::Stage::PROCESS_INPUTS);
 //        _ecs.runSystem(_creatureSystem);
 
         updateGUI();
 
-        // Render world
-        _world.render(&_spriteRenderer);
+        // Render the visible part of the latest world snapshot, interpolated over the tick that produced it
+        {
+            PROFILE_SCOPE("Sprite system");
+            TRACE_SCOPE("Sprite system");
+            Vec2f visibleMin, visibleMax;
+            _viewport.getVisibleRectangle(visibleMin, visibleMax);
+            auto& snapshot = _simulation.getRenderSnapshots().acquire();
+            _spriteRenderer.addSnapshot(snapshot,
+                snapshot.getInterpolationAlpha(RenderSnapshot::Clock::now()), visibleMin, visibleMax);
+        }
         _spriteRenderer.render(_viewport);
 
         // Render ImGui
@@ -152,14 +158,24 @@ void Window::loop(void)
         // Swap draw and display buffers
         SDL_GL_SwapWindow(_window);
 
-        if (!_paused) {
+        if (!_simulation.isPaused()) {
             ++frameId;
         }
 
         uint32_t curTicks = SDL_GetTicks();
+        // Frame rate limit in case vsync does not limit it already
+        if (_settings.window.framerateLimit > 0) {
+            uint32_t minFrameTicks = (uint32_t)(1000 / _settings.window.framerateLimit);
+            if (curTicks - _lastTicks < minFrameTicks) {
+                SDL_Delay(minFrameTicks - (curTicks - _lastTicks));
+                curTicks = SDL_GetTicks();
+            }
+        }
         _frameTicks = curTicks - _lastTicks;
         _lastTicks = curTicks;
     }
+
+    _simulation.stop();
 }
 
 void Window::handleEvent(SDL_Event& event)
@@ -178,7 +194,7 @@ void Window::handleEvent(SDL_Event& event)
                     _quit = true;
                     break;
                 case SDLK_PAUSE:
-                    _paused = !_paused;
+                    _simulation.setPaused(!_simulation.isPaused());
                     break;
                 case SDLK_F12:
                     SDL_SetWindowFullscreen(_window, SDL_GetWindowFlags(_window) ^ SDL_WINDOW_FULLSCREEN);
@@ -223,5 +239,72 @@ void Window::updateGUI()
     ImGui::NewFrame();
 
     ImGui::Begin("Simulation Controls");
+    bool paused = _simulation.isPaused();
+    if (ImGui::Checkbox("Paused", &paused))
+        _simulation.setPaused(paused);
+    float ticksPerSecond = (float)_simulation.getTicksPerSecond();
+    if (ImGui::SliderFloat("Ticks/s", &ticksPerSecond, 1.0f, 10000.0f, "%.0f", ImGuiSliderFlags_Logarithmic))
+        _simulation.setTicksPerSecond(ticksPerSecond);
+    ImGui::Text("Achieved: %.1f ticks/s", _simulation.getAchievedTicksPerSecond());
+    bool parallelUpdates = _simulation.getParallelUpdates();
+    if (ImGui::Checkbox("Parallel entity updates", &parallelUpdates))
+        _simulation.setParallelUpdates(parallelUpdates);
+    ImGui::Text("Frame time: %u ms", _frameTicks);
+
+    // Instance streaming, compare the frame time and the sprite stage timings between the modes
+    bool persistentMapped = _spriteRenderer.getStreamingMode() == SpriteRenderer::StreamingMode::PersistentMapped;
+    if (ImGui::Checkbox("Persistent mapped streaming", &persistentMapped)) {
+        _spriteRenderer.setStreamingMode(persistentMapped ?
+            SpriteRenderer::StreamingMode::PersistentMapped : SpriteRenderer::StreamingMode::BufferData);
+    }
+
+    // Aggregated rendering of the zoomed out world, 0 px always renders the sprites
+    float lodThreshold = _spriteRenderer.getLodThreshold();
+    if (ImGui::SliderFloat("LOD below (px)", &lodThreshold, 0.0f, 16.0f, "%.1f"))
+        _spriteRenderer.setLodThreshold(lodThreshold);
+    ImGui::SameLine();
+    ImGui::TextUnformatted(_spriteRenderer.isLodActive() ? "(aggregated)" : "(sprites)");
+
+#ifdef RPG_WORLD_SIMULATOR_PROFILING
+    // Stage timings over the last Profiler::historySize samples
+    if (ImGui::CollapsingHeader("Profiler", ImGuiTreeNodeFlags_DefaultOpen) &&
+        ImGui::BeginTable("Stages", 4, ImGuiTableFlags_Borders | ImGuiTableFlags_RowBg)) {
+        ImGui::TableSetupColumn("Stage");
+        ImGui::TableSetupColumn("p50 ms");
+        ImGui::TableSetupColumn("p99 ms");
+        ImGui::TableSetupColumn("History");
+        ImGui::TableHeadersRow();
+        for (const auto& stage : Profiler::instance().getStatistics()) {
+            ImGui::TableNextRow();
+            ImGui::TableNextColumn();
+            ImGui::TextUnformatted(stage.name.c_str());
+            ImGui::TableNextColumn();
+            ImGui::Text("%.3f", stage.p50);
+            ImGui::TableNextColumn();
+            ImGui::Text("%.3f", stage.p99);
+            ImGui::TableNextColumn();
+            ImGui::PushID(stage.name.c_str());
+            ImGui::PlotHistogram("##history", stage.durations.data(), (int)stage.durations.size(),
+                0, nullptr, 0.0f, stage.p99*1.25f, ImVec2(160.0f, 24.0f));
+            ImGui::PopID();
+        }
+        ImGui::EndTable();
+    }
+#else
+    ImGui::TextUnformatted("Profiling disabled at compile time");
+#endif
+
+#ifdef RPG_WORLD_SIMULATOR_TRACING
+    // Chrome trace capture of the next _traceTicks ticks
+    if (ImGui::CollapsingHeader("Trace")) {
+        ImGui::InputInt("Ticks", &_traceTicks);
+        int traceTicksLeft = _simulation.getTraceTicksLeft();
+        if (traceTicksLeft > 0)
+            ImGui::Text("Capturing, %d ticks left", traceTicksLeft);
+        else if (ImGui::Button("Capture to trace.json"))
+            _simulation.captureTrace(_traceTicks);
+    }
+#endif
+
     ImGui::End();
 }
@@ -9,91 +9,197 @@
 //
 
 #include "World.hpp"
-#include "SpriteRenderer.hpp"
 #include "CollisionHandler.hpp"
 
 
-World::World(ComponentPool<COMPONENT_TYPES>* componentPool) :
+static Vec2f randomPointInDisk(Random* random, double radius)
+{
+    Vec2f p;
+    do  // Rejection sample inside the radius
+        p << random->uniform((float)-radius, (float)radius), random->uniform((float)-radius, (float)radius);
+    while (p.squaredNorm() > radius*radius);
+    return p;
+}
+
+
+World::World(ComponentPool<COMPONENT_TYPES>* componentPool, double size, uint64_t seed) :
     componentPool   (componentPool),
-    _size           (15.0)
+    _size           (size),
+    _seed           (seed),
+    _tick           (0),
+    _updateMode     (UpdateMode::Parallel),
+    _spatialGrid    (2.0f) // cell size larger than the largest CollisionBody
 {
     constexpr int nNPCs = 8;
-    for (int i=0; i<nNPCs; ++i) {
-        _npcs.emplace_back(componentPool->createEntity<NPC>(Vec2f(
+    componentPool->createEntities<NPC>(&getEntities<NPC>(), nNPCs, [this](std::size_t i) {
+        return std::make_tuple(Vec2f(
             5.0*cos(2.0*PI*((float)i/nNPCs)),
-            5.0*sin(2.0*PI*((float)i/nNPCs)))));
-    }
+            5.0*sin(2.0*PI*((float)i/nNPCs))), _seed, _tick);
+    });
+
+    // Food is created and removed throughout the simulation, reserve for the maximum amount
+    std::size_t maxFood = getMaxFood();
+    getEntities<Food>().reserve(maxFood);
+    componentPool->reserveEntities<Food>(maxFood);
+
+    _commandBuffer.reserve(componentPool->getNumEntitySlots());
 }
 
 void World::update(CollisionHandler* collisionHandler)
 {
+    TRACE_SCOPE("World update");
     spawnFood();
+    _commandBuffer.reserve(componentPool->getNumEntitySlots());
+    updateSpatialGrid();
+
+    std::apply([this](auto&... entities) {
+        (updateEntities(entities), ...);
+    }, _entities);
+
+    applyCommands();
 
-    for (auto& npc : _npcs)
-        npc.update(this);
+    collisionHandler->run();
+    applyCommands();
 
-    for (auto& food : _food)
-        food.update(this);
+    TRACE_COUNTER("NPCs", getNumEntities<NPC>());
+    TRACE_COUNTER("Food", getNumEntities<Food>());
+    ++_tick;
+}
+
+void World::setUpdateMode(UpdateMode updateMode)
+{
+    _updateMode = updateMode;
+}
 
-    componentPool->runSystem<CollisionHandler, Label, CollisionBody, Orientation>(collisionHandler);
+World::UpdateMode World::getUpdateMode() const
+{
+    return _updateMode;
 }
 
-void World::render(SpriteRenderer* renderer)
+void World::removeEntity(EntityId id)
 {
-    componentPool->runSystem<SpriteRenderer, Sprite, Orientation>(renderer);
+    // Stale ids would mark the entity now holding the slot as removed
+    if (componentPool->getEntityHandle(id) != nullptr)
+        _commandBuffer.remove(id);
 }
 
 void World::removeNPC(NPC* npc)
 {
-    // This is utter carbage but it'll do for now
-    _npcs.erase(_npcs.begin() + (npc - _npcs.data()));
+    _commandBuffer.remove(npc->entityId());
 }
 
 void World::removeFood(Food* food)
 {
-    // This is utter carbage but it'll do for now
-    _food.erase(_food.begin() + (food - _food.data()));
+    _commandBuffer.remove(food->entityId());
+}
+
+bool World::isRemoved(EntityId id) const
+{
+    return _commandBuffer.isRemoved(id);
 }
 
 void World::spawnFood()
 {
-    size_t maxFood = static_cast<size_t>((PI*_size*_size) / (5*5));
-    if (_food.size() >= maxFood)
+    PROFILE_SCOPE("Spawn food");
+    TRACE_SCOPE("Spawn food");
+    auto& food = getEntities<Food>();
+    size_t maxFood = getMaxFood();
+    if (food.size() >= maxFood)
         return;
 
-    double nNewFood = rnd(0.0, (PI*_size*_size)/(64*64));
+    // The amount is drawn from the spawn stream of the world and the position of the i:th new food
+    // from the spawn stream keyed by i, so that the food can be created in parallel and still
+    // be the same on every run
+    Random random = getRandom(Random::worldId, Random::Spawn);
+    double nNewFood = random.uniform(0.0, (PI*_size*_size)/(64*64));
     long nNewFoodDiscrete = static_cast<long>(nNewFood);
-    for (long i=0; i<nNewFoodDiscrete; ++i) {
-        if (_food.size() >= maxFood)
-            return;
-
-        Vec2f p;
-        do  // Rejection sample inside the _size radius
-            p << rnd((float)-_size, (float)_size), rnd((float)-_size, (float)_size);
-        while (p.squaredNorm() > _size*_size);
-
-        _food.emplace_back(componentPool->createEntity<Food>(p));
-    }
-    if (rnd(0.0, 1.0) < nNewFood-static_cast<double>(nNewFoodDiscrete)) {
-        Vec2f p;
-        do
-            p << rnd((float)-_size, (float)_size), rnd((float)-_size, (float)_size);
-        while (p.squaredNorm() > _size*_size);
+    componentPool->createEntities<Food>(&food, std::min(maxFood-food.size(), (size_t)nNewFoodDiscrete),
+        [this](std::size_t i) {
+            Random positionRandom = getRandom((EntityId)i, Random::Spawn);
+            return std::make_tuple(randomPointInDisk(&positionRandom, _size), _seed, _tick);
+        }, &_threadPool);
+    if (food.size() >= maxFood)
+        return;
 
-        _food.emplace_back(componentPool->createEntity<Food>(p));
-    }
+    if (random.uniform(0.0, 1.0) < nNewFood-static_cast<double>(nNewFoodDiscrete))
+        food.emplace_back(componentPool->createEntity<Food>(randomPointInDisk(&random, _size), _seed, _tick));
 }
 
 void World::getEntitiesWithinRadius(const Vec2f& point, double radius,
     std::vector<std::pair<EntityId, TypeId>>* entityHandles)
 {
-    _entityFinder.point = point;
-    _entityFinder.radius = radius;
-    _entityFinder.entityHandles = entityHandles;
-    componentPool->runSystem<EntityFinder, Label, Orientation>(&_entityFinder);
+    _spatialGrid.forEachWithinRadius(point, (float)radius, [&](const SpatialGrid::Entry& entry) {
+        // Skip entities removed after the grid was built
+        if (componentPool->getEntityHandle(entry.id) != nullptr && !_commandBuffer.isRemoved(entry.id))
+            entityHandles->emplace_back(entry.id, entry.entityTypeId);
+    });
 }
 
 double World::getSize() const
 {
     return _size;
 }
+
+uint64_t World::getSeed() const
+{
+    return _seed;
+}
+
+uint64_t World::getTick() const
+{
+    return _tick;
+}
+
+Random World::getRandom(EntityId id, uint32_t stream) const
+{
+    return Random(_seed, _tick, id, stream);
+}
+
+std::size_t World::getMaxFood() const
+{
+    return static_cast<std::size_t>((PI*_size*_size) / (5*5));
+}
+
+ThreadPool* World::getThreadPool()
+{
+    return &_threadPool;
+}
+
+void World::updateSpatialGrid()
+{
+    PROFILE_SCOPE("Spatial grid");
+    TRACE_SCOPE("Spatial grid");
+    _spatialGrid.clear();
+    componentPool->runSystem<SpatialGrid, Label, Orientation>(&_spatialGrid);
+    _spatialGrid.build();
+}
+
+void World::updateChunk(EntityContainer<Food>& food, std::size_t begin, std::size_t end)
+{
+    // Same numbers as drawing from the update stream of each food separately
+    EntityId ids[updateChunkSize] {};
+    float growth[updateChunkSize];
+    for (std::size_t i=begin; i<end; ++i)
+        ids[i-begin] = food[i].entityId();
+    Random::uniformBatch(_seed, _tick, Random::Update, ids, end-begin, 0.0f, 0.001f, growth);
+
+    for (std::size_t i=begin; i<end; ++i)
+        food[i].update(this, growth[i-begin]);
+}
+
+void World::applyCommands()
+{
+    PROFILE_SCOPE("Apply commands");
+    TRACE_SCOPE("Apply commands");
+    // Each removal is an O(1) swap-and-pop in the container holding the entity. Removals queued
+    // from parallel loops are sorted first so that the resulting entity order is reproducible.
+    _commandBuffer.sortRemoved();
+    for (auto id : _commandBuffer.getRemoved()) {
+        std::apply([id](auto&... entities) {
+            (entities.remove(id) || ...);
+        }, _entities);
+    }
+
+    _commandBuffer.apply();
+    _commandBuffer.reserve(componentPool->getNumEntitySlots());
+}
@@ -0,0 +1,81 @@
+//
+// Project: rpg_world_simulator
+// File: ComponentPoolTest.cpp
+//
+// Copyright (c) 2024 Miika 'Lehdari' Lehtimäki
+// You may use, distribute and modify this code under the terms
+// of the licence specified in file LICENSE which is distributed
+// with this source code package.
+//
+
+#include "Components.hpp"
+#include "ComponentPool.hpp"
+#include "Food.hpp"
+#include "ThreadPool.hpp"
+
+#include <cstdio>
+#include <vector>
+
+
+static int nFailures = 0;
+
+static void check(bool condition, const char* description)
+{
+    if (!condition) {
+        fprintf(stderr, "FAILED: %s\n", description);
+        ++nFailures;
+    }
+}
+
+
+static void createFood(ComponentPool<COMPONENT_TYPES>* componentPool, std::vector<Food>* food,
+    std::size_t count, ThreadPool* threadPool)
+{
+    componentPool->createEntities<Food>(food, count, [](std::size_t i) {
+        return std::make_tuple(Vec2f((float)i, -(float)i), (uint64_t)1, (uint64_t)0);
+    }, threadPool);
+}
+
+// Parallel bulk creation spanning several pages has to give the same entities as serial creation
+static void testCreateEntitiesParallel()
+{
+    constexpr std::size_t count = 10000;
+
+    ComponentPool<COMPONENT_TYPES> serialPool;
+    std::vector<Food> serialFood;
+    createFood(&serialPool, &serialFood, count, nullptr);
+
+    ThreadPool threadPool(4);
+    ComponentPool<COMPONENT_TYPES> parallelPool;
+    std::vector<Food> parallelFood;
+    createFood(&parallelPool, &parallelFood, count, &threadPool);
+
+    check(parallelFood.size() == count, "all entities are created");
+    bool equal = true;
+    bool handlesValid = true;
+    for (std::size_t i=0; i<count && i<parallelFood.size(); ++i) {
+        auto& s = serialFood[i];
+        auto& p = parallelFood[i];
+        equal &= s.entityId() == p.entityId() &&
+            s.component<Orientation>().getPosition() == p.component<Orientation>().getPosition() &&
+            s.component<CollisionBody>().getRadius() == p.component<CollisionBody>().getRadius();
+        handlesValid &= parallelPool.getEntityHandle(p.entityId()) == &p &&
+            &parallelPool.getComponent<Orientation>(p.entityId()) == &p.component<Orientation>();
+    }
+    check(equal, "parallel and serial creation give the same entities");
+    check(handlesValid, "entity handles and components point to the created entities");
+
+    parallelFood.clear();
+    check(parallelPool.getEntityHandle(serialFood[0].entityId()) == nullptr, "entities are destroyed");
+}
+
+
+int main()
+{
+    testCreateEntitiesParallel();
+
+    if (nFailures > 0)
+        return 1;
+    printf("All tests passed\n");
+    return 0;
+}
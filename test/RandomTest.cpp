@@ -0,0 +1,85 @@
+//
+// Project: rpg_world_simulator
+// File: RandomTest.cpp
+//
+// Copyright (c) 2024 Miika 'Lehdari' Lehtimäki
+// You may use, distribute and modify this code under the terms
+// of the licence specified in file LICENSE which is distributed
+// with this source code package.
+//
+
+#include "Random.hpp"
+
+#include <cstdio>
+#include <vector>
+
+
+static int nFailures = 0;
+
+static void check(bool condition, const char* description)
+{
+    if (!condition) {
+        fprintf(stderr, "FAILED: %s\n", description);
+        ++nFailures;
+    }
+}
+
+
+// uniformBatch has to return the first number of the scalar stream of each id, for counts that
+// fill the lanes partially as well as completely
+static void testUniformBatch()
+{
+    constexpr float min = -2.0f;
+    constexpr float max = 3.0f;
+
+    for (uint64_t seed : {(uint64_t)0, (uint64_t)0x0123456789ABCDEF}) {
+        for (uint64_t tick : {(uint64_t)0, (uint64_t)77, (uint64_t)1 << 40}) {
+            for (uint32_t stream : {(uint32_t)Random::Create, (uint32_t)Random::Update}) {
+                for (std::size_t count : {1, 15, 16, 17, 100}) {
+                    std::vector<EntityId> ids(count);
+                    for (std::size_t i=0; i<count; ++i)
+                        ids[i] = makeEntityId((EntityId)(i*7 + 3), (uint32_t)(i % 5));
+
+                    std::vector<float> batch(count);
+                    Random::uniformBatch(seed, tick, stream, ids.data(), count, min, max, batch.data());
+
+                    bool equal = true;
+                    bool inRange = true;
+                    for (std::size_t i=0; i<count; ++i) {
+                        equal &= batch[i] == Random(seed, tick, ids[i], stream).uniform(min, max);
+                        inRange &= batch[i] >= min && batch[i] < max;
+                    }
+                    check(equal, "uniformBatch equals scalar uniform");
+                    check(inRange, "uniformBatch is within [min, max)");
+                }
+            }
+        }
+    }
+}
+
+// Streams differing in any part of the key are independent, equal keys give equal streams
+static void testStreamKeys()
+{
+    EntityId id = makeEntityId(5, 1);
+    Random reference(1, 2, id, Random::Update);
+    uint32_t first = reference.next();
+
+    check(Random(1, 2, id, Random::Update).next() == first, "equal keys give equal streams");
+    check(Random(2, 2, id, Random::Update).next() != first, "seed changes the stream");
+    check(Random(1, 3, id, Random::Update).next() != first, "tick changes the stream");
+    check(Random(1, 2, makeEntityId(6, 1), Random::Update).next() != first, "entity index changes the stream");
+    check(Random(1, 2, makeEntityId(5, 2), Random::Update).next() != first, "entity generation changes the stream");
+    check(Random(1, 2, id, Random::Spawn).next() != first, "stream index changes the stream");
+}
+
+
+int main()
+{
+    testUniformBatch();
+    testStreamKeys();
+
+    if (nFailures > 0)
+        return 1;
+    printf("All tests passed\n");
+    return 0;
+}
@@ -0,0 +1,96 @@
+//
+// Project: rpg_world_simulator
+// File: WorldTest.cpp
+//
+// Copyright (c) 2024 Miika 'Lehdari' Lehtimäki
+// You may use, distribute and modify this code under the terms
+// of the licence specified in file LICENSE which is distributed
+// with this source code package.
+//
+
+#include "Components.hpp"
+#include "ComponentPool.hpp"
+#include "CollisionHandler.hpp"
+#include "Random.hpp"
+#include "World.hpp"
+
+#include <cstdio>
+
+
+static int nFailures = 0;
+
+static void check(bool condition, const char* description)
+{
+    if (!condition) {
+        fprintf(stderr, "FAILED: %s\n", description);
+        ++nFailures;
+    }
+}
+
+
+// FNV-1a hash of the ids and positions of all entities, in component pool order
+struct WorldHash {
+    uint64_t    hash    {0xCBF29CE484222325};
+
+    void operator()(EntityId id, Orientation& orientation)
+    {
+        add(&id, sizeof(id));
+        add(orientation.getPosition().data(), 2*sizeof(float));
+    }
+
+    void add(const void* data, std::size_t size)
+    {
+        const auto* bytes = static_cast<const uint8_t*>(data);
+        for (std::size_t i=0; i<size; ++i)
+            hash = (hash ^ bytes[i]) * 0x100000001B3;
+    }
+};
+
+
+// Hash of the world state after nTicks, with NPCs created through World::createEntity before
+// the first tick so that they reach the collisions of the first tick without having been updated
+static uint64_t simulate(World::UpdateMode updateMode, long nTicks)
+{
+    constexpr uint64_t seed = 1234;
+    constexpr double worldSize = 30.0;
+    constexpr std::size_t nNPCs = 400;
+
+    ComponentPool<COMPONENT_TYPES> componentPool;
+    World world(&componentPool, worldSize, seed);
+    CollisionHandler collisionHandler(&componentPool, &world);
+    world.setUpdateMode(updateMode);
+
+    // Dense enough for the new NPCs to collide with each other right away
+    Random random(seed, 0, Random::worldId, Random::Spawn);
+    for (std::size_t i=0; i<nNPCs; ++i) {
+        Vec2f position(random.uniform(-10.0f, 10.0f), random.uniform(-10.0f, 10.0f));
+        world.createEntity<NPC>(position);
+    }
+
+    for (long i=0; i<nTicks; ++i)
+        world.update(&collisionHandler);
+
+    WorldHash worldHash;
+    componentPool.runSystem<WorldHash, Orientation>(&worldHash);
+    worldHash.add(&nTicks, sizeof(nTicks));
+    std::size_t nEntities = world.getNumEntities<NPC>() + world.getNumEntities<Food>();
+    worldHash.add(&nEntities, sizeof(nEntities));
+    return worldHash.hash;
+}
+
+
+int main()
+{
+    constexpr long nTicks = 200;
+
+    uint64_t serial1 = simulate(World::UpdateMode::Serial, nTicks);
+    uint64_t serial2 = simulate(World::UpdateMode::Serial, nTicks);
+    uint64_t parallel = simulate(World::UpdateMode::Parallel, nTicks);
+    check(serial1 == serial2, "serial runs with the same seed are identical");
+    check(serial1 == parallel, "serial and parallel runs with the same seed are identical");
+
+    if (nFailures > 0)
+        return 1;
+    printf("All tests passed\n");
+    return 0;
+}